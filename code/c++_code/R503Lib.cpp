@@ -97,6 +97,7 @@ uint8_t R503Lib::begin(long baudrate, uint32_t passwd)
 
     fpsLibrarySize = params.fingerLibrarySize;
     fpsDataPacketSize = params.dataPackageSize;
+    fpsSecurityLevel = params.securityLevel;
 
 
     R503DeviceInfo info;
@@ -228,15 +229,20 @@ uint8_t R503Lib::checkSensor()
  * @brief Sets the security level for the fingerprint sensor.
  *
  * @param level The security level to set. Valid values are between 1 and 5.
- *              1: False Acceptance Rate is lowest, False Rejection Rate is highest.
- *              5: False Acceptance Rate is highest, False Rejection Rate is lowest.
+ *              1: False Acceptance Rate is highest, False Rejection Rate is lowest (loosest).
+ *              5: False Acceptance Rate is lowest, False Rejection Rate is highest (strictest).
  *
  * @return uint8_t Returns R503_OK if the reset was successful, or an error code otherwise.
  */
 uint8_t R503Lib::setSecurityLevel(uint8_t level)
 {
     //SEND_CMD(0x0E, 5, level);
-    return writeParameter(5, level);
+    uint8_t confirmationCode = writeParameter(5, level);
+
+    if (confirmationCode == R503_OK)
+        fpsSecurityLevel = level;
+
+    return confirmationCode;
 }
 
 /**
@@ -570,17 +576,20 @@ uint8_t R503Lib::matchFinger(uint16_t &confidence)
 /**
  * @brief Searches for a finger in the fingerprint library.
  *
+ * Every result feeds the match telemetry (see getMatchStats()).
+ *
  * @param charBuffer The character buffer to search for the finger.
  *
  * @return uint8_t Returns R503_OK if successful, otherwise returns an error code.
  */
 uint8_t R503Lib::searchFinger(uint8_t charBuffer, uint16_t &location, uint16_t &confidence)
 {
-    uint16_t startPage = 0;
-    uint16_t pageCount = fpsLibrarySize;
-    GET_PACKET(5, 0x04, charBuffer, static_cast<uint8_t>(startPage >> 8), static_cast<uint8_t>(startPage), static_cast<uint8_t>(pageCount >> 8), static_cast<uint8_t>(pageCount));
-    location = data[1] << 8 | data[2];
-    confidence = data[3] << 8 | data[4];
+    uint8_t confirmationCode = searchLibrary(charBuffer, location, confidence);
+
+    if (confirmationCode == R503_OK)
+        recordMatch(location, confidence);
+    else if (confirmationCode == R503_NO_MATCH_IN_LIBRARY)
+        noteFailedAttempt();
 
     return confirmationCode;
 }
@@ -600,6 +609,424 @@ uint8_t R503Lib::readIndexTable(uint8_t *table, uint8_t page) {
     return confirmationCode;
 }
 
+/**
+ * @brief Searches the whole library without touching the match telemetry.
+ */
+uint8_t R503Lib::searchLibrary(uint8_t charBuffer, uint16_t &location, uint16_t &confidence)
+{
+    uint16_t startPage = 0;
+    uint16_t pageCount = fpsLibrarySize;
+    GET_PACKET(5, 0x04, charBuffer, static_cast<uint8_t>(startPage >> 8), static_cast<uint8_t>(startPage), static_cast<uint8_t>(pageCount >> 8), static_cast<uint8_t>(pageCount));
+    location = data[1] << 8 | data[2];
+    confidence = data[3] << 8 | data[4];
+
+    return confirmationCode;
+}
+
+/* --------------------------
+    ? Template Maintenance
+----------------------------*/
+
+/**
+ * @brief Finds the lowest unused location in the fingerprint library.
+ *
+ * Walks the index table pages (256 IDs each) needed to cover the library and scans them 32 IDs at a time:
+ * the first clear bit of each word is found with a count-trailing-zeros on its complement.
+ *
+ * @param location Set to the lowest free ID.
+ *
+ * @return uint8_t Returns R503_OK if a slot was found, R503_LIBRARY_FULL if every ID is in use,
+ *         otherwise returns an error code.
+ */
+uint8_t R503Lib::findFreeSlot(uint16_t &location)
+{
+    uint8_t table[32];
+    uint8_t pages = (fpsLibrarySize + 255) / 256;
+
+    for (uint8_t page = 0; page < pages; page++)
+    {
+        uint8_t retVal = readIndexTable(table, page);
+        if (retVal != R503_OK)
+            return retVal;
+
+        for (uint8_t i = 0; i < sizeof(table); i += 4)
+        {
+            // Byte n bit b is ID n * 8 + b, so the bytes form a little-endian word
+            uint32_t used = table[i] | table[i + 1] << 8 | table[i + 2] << 16 | (uint32_t)table[i + 3] << 24;
+            if (used == UINT32_MAX)
+                continue;
+
+            uint16_t id = page * 256 + i * 8 + __builtin_ctz(~used);
+            if (id >= fpsLibrarySize)
+                return R503_LIBRARY_FULL;
+
+            location = id;
+            return R503_OK;
+        }
+    }
+
+    return R503_LIBRARY_FULL;
+}
+
+/**
+ * @brief Checks whether a location in the fingerprint library holds a template.
+ *
+ * @param location The ID to check.
+ * @param used Set to true if a template is stored there.
+ *
+ * @return uint8_t Returns R503_OK if successful, R503_BAD_LOCATION if the ID is outside the library,
+ *         otherwise returns an error code.
+ */
+uint8_t R503Lib::isSlotUsed(uint16_t location, bool &used)
+{
+    uint8_t table[32];
+
+    if (location >= fpsLibrarySize)
+        return R503_BAD_LOCATION;
+
+    uint8_t retVal = readIndexTable(table, location / 256);
+    if (retVal != R503_OK)
+        return retVal;
+
+    uint8_t bit = location % 256;
+    used = table[bit / 8] & (1 << (bit % 8));
+
+    return R503_OK;
+}
+
+/**
+ * @brief Stores the template in character buffer 1 at a chosen location, unless that finger is already enrolled
+ * or the location is taken.
+ *
+ * Call after createTemplate(). Like storeNewTemplate(), the template is first searched against the library.
+ * With overwrite set, the template at location is replaced (its match telemetry is cleared), and re-enrolling
+ * the finger stored there is allowed.
+ *
+ * @param location The ID to store at. Set to the ID of the existing match on R503_DUPLICATE_FINGER.
+ * @param overwrite Set to true to replace a template already stored at location.
+ *
+ * @return uint8_t Returns R503_OK if the template was stored, R503_DUPLICATE_FINGER if the finger is already
+ *         enrolled, R503_SLOT_IN_USE if location holds a template and overwrite is false, otherwise returns an
+ *         error code.
+ */
+uint8_t R503Lib::storeTemplateAt(uint16_t &location, bool overwrite)
+{
+    uint16_t match, confidence;
+    uint8_t retVal = searchLibrary(1, match, confidence);
+
+    if (retVal == R503_OK && !(overwrite && match == location))
+    {
+        location = match;
+        return R503_DUPLICATE_FINGER;
+    }
+
+    if (retVal != R503_OK && retVal != R503_NO_MATCH_IN_LIBRARY)
+        return retVal;
+
+    bool used;
+    retVal = isSlotUsed(location, used);
+    if (retVal != R503_OK)
+        return retVal;
+
+    if (used)
+    {
+        if (!overwrite)
+            return R503_SLOT_IN_USE;
+
+        if (location < R503_MAX_LIBRARY_SIZE)
+        {
+            matchStats[location] = {};
+            lastRefresh[location] = 0;
+        }
+    }
+
+    return storeTemplate(1, location);
+}
+
+/**
+ * @brief Stores the template in character buffer 1 at the lowest free location, unless that finger is already enrolled.
+ *
+ * Call after createTemplate(). The new template is first searched against the library; a match means the
+ * finger is already stored and nothing is written.
+ *
+ * @param location Set to the ID the template was stored at, or to the ID of the existing match.
+ *
+ * @return uint8_t Returns R503_OK if the template was stored, R503_DUPLICATE_FINGER if the finger is already
+ *         enrolled, R503_LIBRARY_FULL if there is no free slot, otherwise returns an error code.
+ */
+uint8_t R503Lib::storeNewTemplate(uint16_t &location)
+{
+    uint16_t match, confidence;
+    uint8_t retVal = searchLibrary(1, match, confidence);
+
+    if (retVal == R503_OK)
+    {
+        location = match;
+        return R503_DUPLICATE_FINGER;
+    }
+
+    if (retVal != R503_NO_MATCH_IN_LIBRARY)
+        return retVal;
+
+    retVal = findFreeSlot(location);
+    if (retVal != R503_OK)
+        return retVal;
+
+    return storeTemplate(1, location);
+}
+
+/**
+ * @brief Configures the adaptive template refresh done by refreshTemplate(). Disabled by default.
+ *
+ * @param enabled Set to true to allow refreshes.
+ * @param minConfidence Only matches scoring at least this confidence are merged into the stored template.
+ * @param minInterval Minimum time in ms between two refreshes of the same ID.
+ */
+void R503Lib::setRefreshPolicy(bool enabled, uint16_t minConfidence, uint32_t minInterval)
+{
+    refreshEnabled = enabled;
+    refreshConfidence = minConfidence;
+    refreshInterval = minInterval;
+}
+
+/**
+ * @brief Merges the features of a fresh match into the stored template of that ID.
+ *
+ * Call right after searchFinger(1, location, confidence) succeeded, while the fresh features are still in
+ * character buffer 1. The stored template is loaded into buffer 2, both are combined with createTemplate()
+ * and the result is written back to the same location, so the template follows slow changes of the finger.
+ * The sensor refuses to combine features of different fingers, in which case the stored template is kept.
+ *
+ * @param location The ID returned by searchFinger().
+ * @param confidence The confidence returned by searchFinger().
+ *
+ * @return uint8_t Returns R503_OK if the template was refreshed, R503_REFRESH_SKIPPED if the policy
+ *         (disabled, low confidence, rate limit) ruled it out, otherwise returns an error code.
+ */
+uint8_t R503Lib::refreshTemplate(uint16_t location, uint16_t confidence)
+{
+    if (!refreshEnabled || confidence < refreshConfidence || location >= R503_MAX_LIBRARY_SIZE)
+        return R503_REFRESH_SKIPPED;
+
+    unsigned long now = millis();
+    if (lastRefresh[location] != 0 && now - lastRefresh[location] < refreshInterval)
+        return R503_REFRESH_SKIPPED;
+
+    uint8_t retVal = getTemplate(2, location);
+    if (retVal != R503_OK)
+        return retVal;
+
+    retVal = createTemplate();
+    if (retVal != R503_OK)
+    {
+#if R503_DEBUG
+        r503_log_e("could not combine features with template %d (code: 0x%02X)\n", location, retVal);
+#endif
+        return retVal;
+    }
+
+    retVal = storeTemplate(1, location);
+    if (retVal == R503_OK)
+        lastRefresh[location] = now ? now : 1;
+
+    return retVal;
+}
+
+/* --------------------------
+    ? Match Telemetry
+----------------------------*/
+
+/**
+ * @brief Counts a failed unlock attempt toward the next successful match.
+ *
+ * searchFinger() calls this on R503_NO_MATCH_IN_LIBRARY. Call it for captures that fail earlier
+ * (bad image, feature extraction) so they show up as retries too.
+ */
+void R503Lib::noteFailedAttempt()
+{
+    unsigned long now = millis();
+
+    if (now - lastFailedAttempt > R503_ATTEMPT_WINDOW)
+        pendingAttempts = 0;
+
+    if (pendingAttempts < UINT16_MAX)
+        pendingAttempts++;
+
+    lastFailedAttempt = now;
+}
+
+/**
+ * @brief Records a successful search in the per-ID and per-security-level statistics.
+ *
+ * Counters are halved together before they saturate, so averages stay valid and recent unlocks dominate.
+ */
+void R503Lib::recordMatch(uint16_t location, uint16_t confidence)
+{
+    uint16_t attempts = 1;
+
+    if (millis() - lastFailedAttempt <= R503_ATTEMPT_WINDOW)
+        attempts += pendingAttempts;
+
+    pendingAttempts = 0;
+
+    if (location < R503_MAX_LIBRARY_SIZE)
+    {
+        R503MatchStats &stats = matchStats[location];
+        uint8_t bin = min(confidence / R503_CONFIDENCE_BIN_WIDTH, R503_CONFIDENCE_BINS - 1);
+
+        if (stats.confidenceHistogram[bin] == UINT8_MAX)
+        {
+            for (uint8_t i = 0; i < R503_CONFIDENCE_BINS; i++)
+                stats.confidenceHistogram[i] >>= 1;
+        }
+        stats.confidenceHistogram[bin]++;
+
+        if (stats.unlocks == UINT16_MAX || UINT16_MAX - stats.attempts < attempts)
+        {
+            stats.unlocks >>= 1;
+            stats.attempts >>= 1;
+        }
+        stats.unlocks++;
+        stats.attempts += attempts;
+    }
+
+    if (fpsSecurityLevel >= 1 && fpsSecurityLevel <= 5)
+    {
+        R503LevelStats &level = levelStats[fpsSecurityLevel - 1];
+
+        if (level.unlocks == UINT16_MAX || UINT16_MAX - level.attempts < attempts)
+        {
+            level.unlocks >>= 1;
+            level.attempts >>= 1;
+        }
+        level.unlocks++;
+        level.attempts += attempts;
+    }
+}
+
+/**
+ * @brief Gets the confidence histogram and retry counts recorded for one ID.
+ *
+ * @param location The ID to query.
+ * @param stats The R503MatchStats struct to fill.
+ *
+ * @return uint8_t Returns R503_OK if successful, R503_BAD_LOCATION if the ID is out of range.
+ */
+uint8_t R503Lib::getMatchStats(uint16_t location, R503MatchStats &stats)
+{
+    if (location >= R503_MAX_LIBRARY_SIZE)
+        return R503_BAD_LOCATION;
+
+    stats = matchStats[location];
+
+    return R503_OK;
+}
+
+/**
+ * @brief Gets the unlock and attempt counts recorded while a security level was active.
+ *
+ * @param level The security level (1 to 5).
+ * @param stats The R503LevelStats struct to fill.
+ *
+ * @return uint8_t Returns R503_OK if successful, R503_BAD_LOCATION if the level is out of range.
+ */
+uint8_t R503Lib::getLevelStats(uint8_t level, R503LevelStats &stats)
+{
+    if (level < 1 || level > 5)
+        return R503_BAD_LOCATION;
+
+    stats = levelStats[level - 1];
+
+    return R503_OK;
+}
+
+/**
+ * @brief Clears all match telemetry.
+ */
+void R503Lib::resetMatchStats()
+{
+    memset(matchStats, 0, sizeof(matchStats));
+    memset(levelStats, 0, sizeof(levelStats));
+    pendingAttempts = 0;
+}
+
+/**
+ * @brief Recommends the security level with the fewest average attempts per unlock.
+ *
+ * Level 1 is the loosest (highest false acceptance rate) and 5 the strictest. Only levels within
+ * [minLevel, maxLevel] with at least R503_TUNER_MIN_UNLOCKS unlocks are compared, and a looser level has to beat
+ * a stricter one by 5% to win, so ties go to the stricter level. Once the best level averages
+ * R503_TUNER_TARGET_ATTEMPTS or better, the next stricter unmeasured level is recommended for trial; if it is
+ * worse, the next looser one is.
+ *
+ * @param minLevel The loosest level allowed (1 to 5).
+ * @param maxLevel The strictest level allowed (1 to 5).
+ *
+ * @return uint8_t The recommended level, or the current level if there is not enough data yet.
+ */
+uint8_t R503Lib::recommendSecurityLevel(uint8_t minLevel, uint8_t maxLevel)
+{
+    minLevel = constrain(minLevel, 1, 5);
+    maxLevel = constrain(maxLevel, minLevel, 5);
+
+    uint8_t best = 0;
+
+    // strictest first, so every candidate is looser than the best so far
+    for (uint8_t level = maxLevel; level >= minLevel; level--)
+    {
+        const R503LevelStats &candidate = levelStats[level - 1];
+        if (candidate.unlocks < R503_TUNER_MIN_UNLOCKS)
+            continue;
+
+        if (best == 0)
+        {
+            best = level;
+            continue;
+        }
+
+        // candidate average < 95% of best average, cross-multiplied
+        const R503LevelStats &current = levelStats[best - 1];
+        if (20ULL * candidate.attempts * current.unlocks < 19ULL * current.attempts * candidate.unlocks)
+            best = level;
+    }
+
+    if (best == 0)
+        return constrain(fpsSecurityLevel, minLevel, maxLevel);
+
+    const R503LevelStats &chosen = levelStats[best - 1];
+    bool goodEnough = 100UL * chosen.attempts <= (uint32_t)R503_TUNER_TARGET_ATTEMPTS * chosen.unlocks;
+
+    // levelStats[best] is level best + 1, levelStats[best - 2] is level best - 1
+    if (goodEnough && best < maxLevel && levelStats[best].unlocks < R503_TUNER_MIN_UNLOCKS)
+        return best + 1;
+    if (!goodEnough && best > minLevel && levelStats[best - 2].unlocks < R503_TUNER_MIN_UNLOCKS)
+        return best - 1;
+
+    return best;
+}
+
+/**
+ * @brief Applies recommendSecurityLevel() to the sensor if it differs from the current level.
+ *
+ * @param minLevel The loosest level allowed (1 to 5).
+ * @param maxLevel The strictest level allowed (1 to 5).
+ *
+ * @return uint8_t Returns R503_OK if the level is unchanged or was set, otherwise returns an error code.
+ */
+uint8_t R503Lib::tuneSecurityLevel(uint8_t minLevel, uint8_t maxLevel)
+{
+    uint8_t level = recommendSecurityLevel(minLevel, maxLevel);
+
+    if (level == fpsSecurityLevel)
+        return R503_OK;
+
+#if R503_DEBUG
+    r503_log_d("security level %d -> %d\n", fpsSecurityLevel, level);
+#endif
+
+    return setSecurityLevel(level);
+}
+
 /* --------------------------
     ? Communication Related
 ----------------------------*/
@@ -19,6 +19,18 @@
 #define R503_PASSWORD 0x0
 #define R503_RECEIVE_TIMEOUT 3000
 #define R503_RESET_TIMEOUT 3000
+#define R503_MAX_LIBRARY_SIZE 200
+
+// Template refresh defaults
+#define R503_REFRESH_CONFIDENCE 200
+#define R503_REFRESH_INTERVAL 21600000UL // 6 hours in ms
+
+// Match telemetry
+#define R503_CONFIDENCE_BINS 8
+#define R503_CONFIDENCE_BIN_WIDTH 50 // last bin collects everything above
+#define R503_ATTEMPT_WINDOW 15000    // failed attempts within this window (ms) count toward the next match
+#define R503_TUNER_MIN_UNLOCKS 20    // unlocks needed before a security level's statistics are trusted
+#define R503_TUNER_TARGET_ATTEMPTS 120 // average attempts per unlock (x100) considered good enough
 
 // Confirmation Codes
 #define R503_OK 0x00
@@ -29,10 +41,12 @@
 #define R503_FEATURE_FAIL 0x07
 #define R503_NO_MATCH 0x08
 #define R503_NO_MATCH_IN_LIBRARY 0x09
+#define R503_COMBINE_FAIL 0x0A
 #define R503_WRONG_PASSWORD 0x13
 #define R503_NO_IMAGE 0x15
 #define R503_BAD_LOCATION 0x0B
 #define R503_ERROR_WRITING_FLASH 0x18
+#define R503_LIBRARY_FULL 0x1F
 #define R503_SENSOR_ABNORMAL 0x29
 #define R503_ERROR_TRANSFER_DATA = 0x0E
 
@@ -44,6 +58,9 @@
 #define R503_INVALID_START_CODE 0xE6
 #define R503_INVALID_BAUDRATE 0xE8
 #define R503_TIMEOUT 0xE9
+#define R503_REFRESH_SKIPPED 0xEA
+#define R503_DUPLICATE_FINGER 0xEB
+#define R503_SLOT_IN_USE 0xEC
 
 struct R503Parameters
 {
@@ -69,6 +86,19 @@ struct R503DeviceInfo
     uint16_t databaseSize;
 };
 
+struct R503MatchStats
+{
+    uint8_t confidenceHistogram[R503_CONFIDENCE_BINS]; // all bins are halved when one saturates
+    uint16_t unlocks;                                  // successful searches
+    uint16_t attempts;                                 // searches spent on those unlocks, including failed retries
+};
+
+struct R503LevelStats
+{
+    uint16_t unlocks;
+    uint16_t attempts;
+};
+
 typedef enum
 {
     aLEDBreathing = 1, // Breathing
@@ -132,6 +162,22 @@ public:
     uint8_t searchFinger(uint8_t charBuffer, uint16_t &location, uint16_t &confidence);
     uint8_t readIndexTable(uint8_t *table, uint8_t page = 0);
 
+    // Template Maintenance
+    void setRefreshPolicy(bool enabled, uint16_t minConfidence = R503_REFRESH_CONFIDENCE, uint32_t minInterval = R503_REFRESH_INTERVAL);
+    uint8_t refreshTemplate(uint16_t location, uint16_t confidence);
+    uint8_t findFreeSlot(uint16_t &location);
+    uint8_t isSlotUsed(uint16_t location, bool &used);
+    uint8_t storeTemplateAt(uint16_t &location, bool overwrite = false);
+    uint8_t storeNewTemplate(uint16_t &location);
+
+    // Match Telemetry
+    void noteFailedAttempt();
+    uint8_t getMatchStats(uint16_t location, R503MatchStats &stats);
+    uint8_t getLevelStats(uint8_t level, R503LevelStats &stats);
+    void resetMatchStats();
+    uint8_t recommendSecurityLevel(uint8_t minLevel = 1, uint8_t maxLevel = 5);
+    uint8_t tuneSecurityLevel(uint8_t minLevel = 1, uint8_t maxLevel = 5);
+
     // Debug
     uint8_t printDeviceInfo();
     uint8_t printParameters();
@@ -149,6 +195,22 @@ private:
     uint16_t fpsDataPacketSize;
     uint16_t fpsTemplateSize;
 
+    // Template refresh policy
+    bool refreshEnabled = false;
+    uint16_t refreshConfidence = R503_REFRESH_CONFIDENCE;
+    uint32_t refreshInterval = R503_REFRESH_INTERVAL;
+    uint32_t lastRefresh[R503_MAX_LIBRARY_SIZE] = {0}; // millis() of the last refresh per ID, 0 = never
+
+    // Match telemetry
+    uint8_t fpsSecurityLevel = 0;
+    uint16_t pendingAttempts = 0;
+    uint32_t lastFailedAttempt = 0;
+    R503MatchStats matchStats[R503_MAX_LIBRARY_SIZE] = {};
+    R503LevelStats levelStats[5] = {};
+
+    void recordMatch(uint16_t location, uint16_t confidence);
+    uint8_t searchLibrary(uint8_t charBuffer, uint16_t &location, uint16_t &confidence);
+
     // Packet handling
     void sendPacket(R503Packet const &packet);
     uint8_t receivePacket(R503Packet &packet);
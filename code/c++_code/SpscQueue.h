@@ -0,0 +1,72 @@
+/**
+ * @file SpscQueue.h
+ * @brief Lock-free single-producer/single-consumer ring buffer.
+ *
+ * Used to pass messages between the two FreeRTOS tasks of the fingerprint firmware without taking a lock,
+ * so neither side can be held up by the other. Exactly one task may call push() and exactly one task may
+ * call pop(); they may run on different cores.
+ */
+
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <stdint.h>
+
+template <typename T, uint8_t N>
+class SpscQueue
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+public:
+    /**
+     * @brief Appends an item (producer side).
+     *
+     * @return true if the item was queued, false if the queue is full.
+     */
+    bool push(const T &item)
+    {
+        uint8_t head = head_.load(std::memory_order_relaxed);
+        uint8_t tail = tail_.load(std::memory_order_acquire);
+
+        if (static_cast<uint8_t>(head - tail) == N)
+            return false;
+
+        items_[head & (N - 1)] = item;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Removes the oldest item (consumer side).
+     *
+     * @return true if an item was copied to item, false if the queue is empty.
+     */
+    bool pop(T &item)
+    {
+        uint8_t tail = tail_.load(std::memory_order_relaxed);
+        uint8_t head = head_.load(std::memory_order_acquire);
+
+        if (head == tail)
+            return false;
+
+        item = items_[tail & (N - 1)];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief True if nothing is queued. Safe from either side, but only a snapshot.
+     */
+    bool empty() const
+    {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+private:
+    T items_[N];
+    std::atomic<uint8_t> head_{0}; // written by the producer only
+    std::atomic<uint8_t> tail_{0}; // written by the consumer only
+};
+
+#endif
@@ -0,0 +1,74 @@
+/**
+ * @file VaultLink.cpp
+ * @brief Framed serial link from the ESP32 to the LCD/actuator ATmega.
+ */
+
+#include "VaultLink.h"
+
+/**
+ * @brief Constructor for VaultLink class.
+ *
+ * @param serial Pointer to the HardwareSerial the ATmega is wired to.
+ * @param txPin TX pin number (the link is transmit-only).
+ */
+VaultLink::VaultLink(HardwareSerial *serial, int8_t txPin)
+{
+    linkSerial = serial;
+    linkTxPin = txPin;
+}
+
+/**
+ * @brief Starts the UART. The RX pin is left unassigned.
+ *
+ * @param baudrate Must match VAULT_LINK_BAUD on the ATmega side.
+ */
+void VaultLink::begin(uint32_t baudrate)
+{
+    linkSerial->begin(baudrate, SERIAL_8N1, -1, linkTxPin);
+}
+
+/**
+ * @brief Sends one event frame. Returns once the frame is queued in the UART FIFO.
+ *
+ * @param type One of vaultLinkEvent_t.
+ * @param id R503 template ID of the matched finger.
+ * @param confidence Match confidence reported by the sensor.
+ */
+void VaultLink::send(uint8_t type, uint16_t id, uint16_t confidence)
+{
+    uint8_t frame[VAULT_LINK_FRAME_SIZE] = {
+        VAULT_LINK_SYNC,
+        sequence++,
+        type,
+        lowByte(id), highByte(id),
+        lowByte(confidence), highByte(confidence),
+        0};
+
+    frame[VAULT_LINK_FRAME_SIZE - 1] = crc8(&frame[1], VAULT_LINK_FRAME_SIZE - 2);
+    linkSerial->write(frame, sizeof(frame));
+}
+
+/**
+ * @brief Waits until every queued frame has left the UART, e.g. before light sleep stops its clock.
+ */
+void VaultLink::flush()
+{
+    linkSerial->flush();
+}
+
+/**
+ * @brief CRC-8/CCITT, bit-for-bit identical to avr-libc's _crc8_ccitt_update().
+ */
+uint8_t VaultLink::crc8(const uint8_t *data, uint8_t length)
+{
+    uint8_t crc = 0;
+
+    for (uint8_t i = 0; i < length; i++)
+    {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++)
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+
+    return crc;
+}
@@ -0,0 +1,47 @@
+/**
+ * @file VaultLink.h
+ * @brief Framed serial link from the ESP32 to the LCD/actuator ATmega.
+ *
+ * Replaces the two identity GPIOs. Every event is one fixed 8-byte frame:
+ *
+ *   | 0xA5 | seq | type | id (LE16) | confidence (LE16) | CRC-8 |
+ *
+ * The CRC is CRC-8/CCITT (polynomial 0x07, init 0) over seq..confidence, the same as avr-libc's
+ * _crc8_ccitt_update(). The receiver lives in code/c_code/vault_link.c; keep both sides in step.
+ */
+
+#ifndef VAULTLINK_H
+#define VAULTLINK_H
+
+#include <Arduino.h>
+#include <HardwareSerial.h>
+
+#define VAULT_LINK_BAUD 250000 // exact divisor on the 16 MHz ATmega (UBRR0 = 7 with U2X0)
+#define VAULT_LINK_SYNC 0xA5
+#define VAULT_LINK_FRAME_SIZE 8
+
+typedef enum
+{
+    vlIdentity = 1, // finger matched, id/confidence are valid
+    vlReject,       // finger did not match
+    vlReset,        // reset line seen, back to idle
+} vaultLinkEvent_t;
+
+class VaultLink
+{
+public:
+    VaultLink(HardwareSerial *serial, int8_t txPin);
+
+    void begin(uint32_t baudrate = VAULT_LINK_BAUD);
+    void send(uint8_t type, uint16_t id = 0, uint16_t confidence = 0);
+    void flush();
+
+private:
+    HardwareSerial *linkSerial;
+    int8_t linkTxPin;
+    uint8_t sequence = 0;
+
+    static uint8_t crc8(const uint8_t *data, uint8_t length);
+};
+
+#endif
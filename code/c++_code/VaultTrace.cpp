@@ -0,0 +1,65 @@
+/**
+ * @file VaultTrace.cpp
+ * @brief Timestamped trace ring for the fingerprint firmware.
+ */
+
+#include "VaultTrace.h"
+
+/**
+ * @brief Constructor for VaultTrace class.
+ *
+ * @param name MCU name written on every dump line.
+ */
+VaultTrace::VaultTrace(const char *name)
+{
+    mcuName = name;
+}
+
+/**
+ * @brief Records an event, overwriting the oldest one when the ring is full.
+ *
+ * Safe to call from either task and from interrupt handlers.
+ *
+ * @param event One of vaultTraceEvent_t.
+ * @param arg Event specific value.
+ */
+void IRAM_ATTR VaultTrace::mark(uint8_t event, uint16_t arg)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL_SAFE(&lock);
+    ring[head] = {now, event, arg};
+    head = (head + 1) & (VAULT_TRACE_SIZE - 1);
+    if (count < VAULT_TRACE_SIZE)
+        count++;
+    else
+        lost++;
+    portEXIT_CRITICAL_SAFE(&lock);
+}
+
+/**
+ * @brief Prints every recorded event, oldest first, and empties the ring.
+ *
+ * @param out Where to print the TRACE lines (usually Serial).
+ */
+void VaultTrace::dump(Print &out)
+{
+    Entry copy[VAULT_TRACE_SIZE];
+    uint16_t n, dropped;
+
+    // copy out under the lock, print without it
+    portENTER_CRITICAL(&lock);
+    n = count;
+    dropped = lost;
+    for (uint16_t i = 0; i < n; i++)
+        copy[i] = ring[(head - n + i) & (VAULT_TRACE_SIZE - 1)];
+    count = 0;
+    lost = 0;
+    portEXIT_CRITICAL(&lock);
+
+    if (dropped)
+        out.printf("TRACE,%s,%lld,%u,%u\n", mcuName, esp_timer_get_time(), vtOverflow, dropped);
+
+    for (uint16_t i = 0; i < n; i++)
+        out.printf("TRACE,%s,%lld,%u,%u\n", mcuName, copy[i].timeUs, copy[i].event, copy[i].arg);
+}
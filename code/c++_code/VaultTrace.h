@@ -0,0 +1,58 @@
+/**
+ * @file VaultTrace.h
+ * @brief Timestamped trace ring for the fingerprint firmware.
+ *
+ * The ESP32's part of the cross-MCU unlock trace. Events are stamped with esp_timer_get_time() and dumped
+ * over USB serial in the same line format as code/c_code/trace.c:
+ *
+ *   TRACE,esp32,<time us>,<event>,<arg>
+ *
+ * The reset line from the LCD ATmega doubles as the sync pulse; record vtSync on its rising edge.
+ * host_code/trace_merge.cpp aligns the clocks on those pulses. Event IDs share one numbering with trace.h.
+ */
+
+#ifndef VAULTTRACE_H
+#define VAULTTRACE_H
+
+#include <Arduino.h>
+
+#define VAULT_TRACE_SIZE 64 // events kept, power of two
+
+typedef enum
+{
+    vtSync = 0x00,         // reset line rising edge
+    vtOverflow = 0x01,     // arg = events lost since the last dump
+    vtFingerDown = 0x10,   // takeImage() captured a finger
+    vtFeatures = 0x11,     // extractFeatures() done, arg = confirmation code
+    vtSearch = 0x12,       // searchFinger() done, arg = matched ID or 0xFFFF
+    vtLinkSent = 0x13,     // frame handed to the ATmega link, arg = vaultLinkEvent_t
+    vtFingerLifted = 0x14, // finger left the sensor
+    vtSleep = 0x15,        // sensor parked, entering light sleep
+    vtWake = 0x16,         // woken from light sleep, arg = 0 touch, 1 reset line
+} vaultTraceEvent_t;
+
+class VaultTrace
+{
+public:
+    VaultTrace(const char *name);
+
+    void mark(uint8_t event, uint16_t arg = 0);
+    void dump(Print &out);
+
+private:
+    struct Entry
+    {
+        int64_t timeUs;
+        uint8_t event;
+        uint16_t arg;
+    };
+
+    const char *mcuName;
+    Entry ring[VAULT_TRACE_SIZE];
+    uint16_t head = 0;
+    uint16_t count = 0;
+    uint16_t lost = 0;
+    portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+};
+
+#endif
@@ -1,110 +1,312 @@
 #include <R503Lib.h>
+#include "SpscQueue.h"
+#include "VaultLink.h"
+#include "VaultTrace.h"
+#include <atomic>
+#include <driver/gpio.h>
+#include <esp_sleep.h>
 
 #define fpsSerial Serial1
 R503Lib fps(&fpsSerial, 44, 43, 0xFFFFFFFF);
-
-const int UNLOCK_PIN0 = 10;  // FeatherS2 pin 10 (GPIO10) orange -> ATMega PC1
-const int UNLOCK_PIN1 = 11;  // FeatherS2 pin 11 (GPIO11) yellow -> ATMega PC2
-const int RESET_PIN = 7;   // FeatherS2 pin 7 (GPIO11) white -> ATMega PC0
 // rx = yellow
 // tx = purple
 
+const int VAULT_LINK_TX = 10;  // FeatherS2 pin 10 (GPIO10) orange -> ATMega PD0 (RXD0)
+const int RESET_PIN = 7;   // FeatherS2 pin 7 (GPIO11) white -> ATMega PC0
+const int TOUCH_PIN = 5;   // FeatherS2 pin 5 (GPIO5) <- R503 WAKEUP (pin 5), R503 3.3VT (pin 6) on 3.3V
+#define TOUCH_ACTIVE HIGH  // WAKEUP level while a finger is on the sensor
 
-void setup() {
-  Serial.begin(115200);
+// UART0 is free while Serial is the native USB CDC port
+HardwareSerial vaultSerial(0);
+VaultLink link(&vaultSerial, VAULT_LINK_TX);
+VaultTrace trace("esp32");
 
-  pinMode(UNLOCK_PIN0, OUTPUT);
-  digitalWrite(UNLOCK_PIN0, LOW);
-  pinMode(UNLOCK_PIN1, OUTPUT);
-  digitalWrite(UNLOCK_PIN1, LOW);
-  pinMode(RESET_PIN, INPUT);
+// The sensor task owns the R503 UART and everything R503Lib does; the vault task owns the ATmega link.
+// On single-core parts (the FeatherS2's ESP32-S2) both run on core 0 and are separated by priority only.
+#if CONFIG_FREERTOS_UNICORE
+#define SENSOR_CORE 0
+#define VAULT_CORE 0
+#else
+#define SENSOR_CORE 0
+#define VAULT_CORE 1
+#endif
 
+#define SENSOR_POLL_MS 50      // takeImage() period while no finger is on the sensor
+#define FINGER_LIFT_TIMEOUT_MS 3000
 
-  Serial1.begin(57600, SERIAL_8N1, 44, 43);
-  delay(200);
+// Light sleep: after SENSOR_IDLE_MS without a finger the sensor task turns the aura LED off and light-sleeps the
+// ESP32 until the touch line or the reset line wakes it. RAM, both UARTs and so R503Lib's state survive light
+// sleep, and the R503 stays powered, so capturing resumes without begin(). The native USB serial port drops
+// while asleep; build with LIGHT_SLEEP 0 to keep it connected.
+#ifndef LIGHT_SLEEP
+#define LIGHT_SLEEP 1
+#endif
+#define SENSOR_IDLE_MS 10000
+#define WAKE_CAPTURE_TARGET_MS 300 // touch wake-up to captured image, reported on every touch wake-up
 
-  if (fps.begin(57600, 0x0) != R503_OK) {
-    Serial.println("sensor error");
-    while (1) delay(10);
-  }
+// sensor task -> vault task
+enum SensorEventType : uint8_t { EV_MATCH, EV_NO_MATCH, EV_ERROR };
 
-  fps.setAuraLED(aLEDBreathing, aLEDBlue, 50, 255);
-  Serial.println("ready");
-}
+struct SensorEvent {
+  SensorEventType type;
+  uint8_t code;         // R503 confirmation code
+  uint16_t id;
+  uint16_t confidence;
+};
 
-void loop() {
-  // checks reset pin
-  if (digitalRead(RESET_PIN) == HIGH) {
-      digitalWrite(UNLOCK_PIN0, LOW);
-      digitalWrite(UNLOCK_PIN1, LOW);
+// vault task -> sensor task
+enum SensorCommandType : uint8_t { CMD_LED, CMD_RESET };
 
-      // reset LED to idle
-      fps.setAuraLED(aLEDBreathing, aLEDBlue, 50, 255);
+struct SensorCommand {
+  SensorCommandType type;
+  uint8_t control;
+  uint8_t color;
+  uint8_t speed;
+};
+
+SpscQueue<SensorEvent, 8> sensorEvents;
+SpscQueue<SensorCommand, 8> sensorCommands;
+
+TaskHandle_t sensorTaskHandle;
+TaskHandle_t vaultTaskHandle;
+std::atomic<bool> vaultIdle{false}; // vault task waiting for work, nothing half-sent on the link
+
+// ------------------------------------ SENSOR CORE --------------------------------------
+
+void sendEvent(SensorEventType type, uint8_t code, uint16_t id = 0, uint16_t confidence = 0) {
+  SensorEvent ev = {type, code, id, confidence};
+  if (!sensorEvents.push(ev)) {
+    Serial.println("sensor event queue full");
+  }
+  xTaskNotifyGive(vaultTaskHandle);
+}
 
+// runs the LED/reset requests queued by the vault task between sensor transactions, returns true if there were any
+bool handleSensorCommands() {
+  SensorCommand cmd;
+  bool handled = false;
+  while (sensorCommands.pop(cmd)) {
+    handled = true;
+    if (cmd.type == CMD_RESET) {
       // soft-reset internal R503 state machine
       // fps.softReset();
-      // delay(200);
-
-      Serial.println("RESET received -> returning to idle state");
-      
-      // Wait for reset line to go LOW again
-      while (digitalRead(RESET_PIN) == HIGH) {
-        delay(10);
-        }
-      
-      return;
+      fps.setAuraLED(aLEDBreathing, aLEDBlue, 50, 255);
+    } else {
+      fps.setAuraLED(cmd.control, cmd.color, cmd.speed, 255);
     }
+  }
+  return handled;
+}
 
-  int ret = fps.takeImage();
+// nothing for the vault task to send and no reason to be awake
+bool readyToSleep() {
+  return vaultIdle && sensorEvents.empty() && sensorCommands.empty() && digitalRead(RESET_PIN) == LOW;
+}
 
-  if (ret == R503_NO_FINGER) {
-    delay(50);
-    return;
-  }
+// Parks the sensor and light-sleeps until a finger touches it or the reset line rises; returns true for a touch.
+// Both wake-ups are level triggered, so a finger already down or a reset already high wakes it straight away.
+bool lightSleep() {
+  fps.setAuraLED(aLEDOFF, aLEDBlue, 0, 0);
+  trace.mark(vtSleep);
+  link.flush();
+  Serial.flush();
+
+  // the reset line's edge interrupt stays off while its pin is set up as a level wake-up source, or the level
+  // would keep retriggering it once awake
+  gpio_intr_disable((gpio_num_t)RESET_PIN);
+  gpio_wakeup_enable((gpio_num_t)TOUCH_PIN, TOUCH_ACTIVE == HIGH ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
+  gpio_wakeup_enable((gpio_num_t)RESET_PIN, GPIO_INTR_HIGH_LEVEL);
+  esp_sleep_enable_gpio_wakeup();
 
-  if (ret != R503_OK) {
-    Serial.printf("takeImage err 0x%02X\n", ret);
-    return;
+  esp_light_sleep_start();
+
+  gpio_wakeup_disable((gpio_num_t)TOUCH_PIN);
+  gpio_wakeup_disable((gpio_num_t)RESET_PIN);
+  gpio_set_intr_type((gpio_num_t)RESET_PIN, GPIO_INTR_ANYEDGE);
+  gpio_intr_enable((gpio_num_t)RESET_PIN);
+
+  bool reset = digitalRead(RESET_PIN) == HIGH;
+  trace.mark(vtWake, reset);
+  if (reset) {
+    // the rising edge came while its interrupt was off: stamp the sync pulse now (late by the wake-up time,
+    // well under a millisecond) and let the vault task see the line
+    trace.mark(vtSync);
+    xTaskNotifyGive(vaultTaskHandle);
   }
+  return !reset;
+}
+
+void sensorTask(void *arg) {
+  unsigned long idleSince = millis();
+  int64_t wokeUs = 0; // esp_timer_get_time() of the last touch wake-up, until its finger is captured
+
+  for (;;) {
+    if (handleSensorCommands()) {
+      idleSince = millis(); // leave a new LED state on show
+    }
+
+    int ret = fps.takeImage();
+
+    if (ret == R503_NO_FINGER) {
+      if (LIGHT_SLEEP && millis() - idleSince >= SENSOR_IDLE_MS && readyToSleep()) {
+        // a touch goes straight back to takeImage(), no poll delay
+        wokeUs = lightSleep() ? esp_timer_get_time() : 0;
+        idleSince = millis();
+        continue;
+      }
+      // sleeps until the next poll, or until the vault task queues a command
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SENSOR_POLL_MS));
+      continue;
+    }
+
+    if (ret != R503_OK) {
+      Serial.printf("takeImage err 0x%02X\n", ret);
+      continue;
+    }
 
-  Serial.println("finger detected");
-  fps.setAuraLED(aLEDBreathing, aLEDYellow, 120, 255);
+    trace.mark(vtFingerDown);
+    Serial.println("finger detected");
+    if (wokeUs) {
+      unsigned wakeMs = (esp_timer_get_time() - wokeUs) / 1000;
+      Serial.printf("wake to capture %u ms%s\n", wakeMs, wakeMs > WAKE_CAPTURE_TARGET_MS ? " (over target)" : "");
+      wokeUs = 0;
+    }
+    fps.setAuraLED(aLEDBreathing, aLEDYellow, 120, 255);
+
+    ret = fps.extractFeatures(1);
+    trace.mark(vtFeatures, ret);
+    if (ret != R503_OK) {
+      Serial.printf("extract err 0x%02X\n", ret);
+      fps.noteFailedAttempt();
+      sendEvent(EV_ERROR, ret);
+    } else {
+      uint16_t id, conf;
+      ret = fps.searchFinger(1, id, conf);
+      trace.mark(vtSearch, ret == R503_OK ? id : 0xFFFF);
+
+      if (ret == R503_OK) {
+        sendEvent(EV_MATCH, ret, id, conf);
 
-  ret = fps.extractFeatures(1);
-  if (ret != R503_OK) {
-    Serial.printf("extract err 0x%02X\n", ret);
-    fps.setAuraLED(aLEDRed, aLEDBreathing, 100, 255);
-    return;
+        // the vault task is already signalling the unlock, so template upkeep costs it nothing
+        if (fps.refreshTemplate(id, conf) == R503_OK) {
+          Serial.printf("template %d refreshed (confidence %d)\n", id, conf);
+        }
+
+        // never looser than the factory default of 3 on a vault, up to the strictest level
+        R503MatchStats stats;
+        fps.getMatchStats(id, stats);
+        Serial.printf("ID %d: %d unlocks, %d attempts, recommended security level %d\n",
+                      id, stats.unlocks, stats.attempts, fps.recommendSecurityLevel(3, 5));
+      } else {
+        sendEvent(EV_NO_MATCH, ret);
+      }
+    }
+
+    // one decision per touch: wait for the finger to leave before capturing again
+    handleSensorCommands();
+    unsigned long liftStart = millis();
+    while (fps.takeImage() != R503_NO_FINGER && millis() - liftStart < FINGER_LIFT_TIMEOUT_MS) {
+      handleSensorCommands();
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SENSOR_POLL_MS));
+    }
+    trace.mark(vtFingerLifted);
+    idleSince = millis();
   }
+}
 
-  uint16_t id, conf;
-  ret = fps.searchFinger(1, id, conf);
-  // id0 = 01
-  if (ret == R503_OK && id == 0) {
-    Serial.printf("AUTHORIZED: ID %d\n", id);
-    fps.setAuraLED(aLEDBreathing, aLEDGreen, 255, 255);
-    digitalWrite(UNLOCK_PIN0, LOW);  // stay low
-    digitalWrite(UNLOCK_PIN1, HIGH);   // stay high
+// ------------------------------------ VAULT CORE --------------------------------------
+
+void IRAM_ATTR resetPinISR() {
+  // the rising edge is also the trace sync pulse, stamp it before anything else
+  if (digitalRead(RESET_PIN) == HIGH) {
+    trace.mark(vtSync);
   }
-  // id1 = 10
-  else if (ret == R503_OK && id == 1) {
-    Serial.printf("AUTHORIZED: ID %d\n", id);
-    fps.setAuraLED(aLEDBreathing, aLEDGreen, 255, 255);
-    digitalWrite(UNLOCK_PIN0, HIGH);   // stay high
-    digitalWrite(UNLOCK_PIN1, LOW);  // stay low
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(vaultTaskHandle, &woken);
+  portYIELD_FROM_ISR(woken);
+}
+
+void sendCommand(SensorCommandType type, uint8_t control = 0, uint8_t color = 0, uint8_t speed = 0) {
+  SensorCommand cmd = {type, control, color, speed};
+  if (!sensorCommands.push(cmd)) {
+    Serial.println("sensor command queue full");
   }
-  // id2 = 11
-  else if (ret == R503_OK && id == 2) {
-    Serial.printf("AUTHORIZED: ID %d\n", id);
-    fps.setAuraLED(aLEDBreathing, aLEDGreen, 255, 255);
-    digitalWrite(UNLOCK_PIN0, HIGH);  // stay high
-    digitalWrite(UNLOCK_PIN1, HIGH);  // stay high
+  xTaskNotifyGive(sensorTaskHandle);
+}
+
+void vaultTask(void *arg) {
+  bool resetActive = false;
+
+  for (;;) {
+    // woken by the reset line ISR or a sensor event
+    vaultIdle = true;
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    vaultIdle = false;
+
+    bool resetHigh = digitalRead(RESET_PIN) == HIGH;
+    if (resetHigh && !resetActive) {
+      link.send(vlReset);
+      trace.mark(vtLinkSent, vlReset);
+      sendCommand(CMD_RESET);
+      Serial.println("RESET received -> returning to idle state");
+      // one unlock cycle per dump, ending on the sync pulse
+      trace.dump(Serial);
+    }
+    resetActive = resetHigh;
+
+    SensorEvent ev;
+    while (sensorEvents.pop(ev)) {
+      // no unlocks while the ATmega holds the reset line
+      if (resetActive) {
+        continue;
+      }
+
+      if (ev.type == EV_MATCH) {
+        link.send(vlIdentity, ev.id, ev.confidence);
+        trace.mark(vtLinkSent, vlIdentity);
+        Serial.printf("AUTHORIZED: ID %d (confidence %d)\n", ev.id, ev.confidence);
+        sendCommand(CMD_LED, aLEDBreathing, aLEDGreen, 255);
+      }
+      else {
+        link.send(vlReject);
+        trace.mark(vtLinkSent, vlReject);
+        Serial.println("unauthorized or no match");
+        sendCommand(CMD_LED, aLEDBreathing, aLEDRed, 255);
+      }
+    }
   }
-  // no match = 00
-  else {
-    Serial.println("unauthorized or no match");
-    fps.setAuraLED(aLEDBreathing, aLEDRed, 255, 255);
+}
+
+void setup() {
+  Serial.begin(115200);
+
+  link.begin();
+  pinMode(RESET_PIN, INPUT);
+  pinMode(TOUCH_PIN, INPUT);
+
+
+  Serial1.begin(57600, SERIAL_8N1, 44, 43);
+  delay(200);
+
+  if (fps.begin(57600, 0x0) != R503_OK) {
+    Serial.println("sensor error");
+    while (1) delay(10);
   }
 
-  delay(300);
+  // fold high-confidence matches back into the stored templates, at most every 6 hours per ID
+  fps.setRefreshPolicy(true, R503_REFRESH_CONFIDENCE, R503_REFRESH_INTERVAL);
+
+  fps.setAuraLED(aLEDBreathing, aLEDBlue, 50, 255);
+
+  // vault logic gets the higher priority so it preempts sensor work on single-core parts
+  xTaskCreatePinnedToCore(vaultTask, "vault", 4096, NULL, 3, &vaultTaskHandle, VAULT_CORE);
+  xTaskCreatePinnedToCore(sensorTask, "sensor", 8192, NULL, 2, &sensorTaskHandle, SENSOR_CORE);
+  attachInterrupt(digitalPinToInterrupt(RESET_PIN), resetPinISR, CHANGE);
+
+  Serial.println("ready");
+}
+
+void loop() {
+  // all work happens in the sensor and vault tasks
+  vTaskDelete(NULL);
 }
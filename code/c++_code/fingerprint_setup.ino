@@ -187,15 +187,49 @@ void enrollFinger()
 
     Serial.flush(); // flush the buffer
 
-    Serial.println("Where do you want to store the fingerprint (ID)?");
+    Serial.println("Where do you want to store the fingerprint (ID, or 'a' for the lowest free slot)?");
 
     do
     {
         str = Serial.readStringUntil('\n');
     } while (str.length() < 1);
 
-    uint16_t location = str.toInt();
-    Serial.printf(" << %d\n\n", location);
+    bool autoLocation = (str.charAt(0) == 'a');
+    uint16_t location = autoLocation ? 0 : str.toInt();
+    bool overwrite = false;
+    if (autoLocation)
+        Serial.printf(" << auto\n\n");
+    else
+        Serial.printf(" << %d\n\n", location);
+
+    // a typed ID must not silently replace someone else's finger
+    if (!autoLocation)
+    {
+        bool used;
+        ret = fp->isSlotUsed(location, used);
+        if (ret != R503_OK)
+        {
+            Serial.printf("[X] Can't use location %d (code: 0x%02X)\n", location, ret);
+            return;
+        }
+
+        if (used)
+        {
+            Serial.printf("[!] Location %d already holds a template, overwrite it? (y/n)\n", location);
+            do
+            {
+                str = Serial.readStringUntil('\n');
+            } while (str.length() < 1);
+
+            if (str.charAt(0) != 'y')
+            {
+                Serial.println(" << n\n\nNothing enrolled");
+                return;
+            }
+            Serial.println(" << y\n");
+            overwrite = true;
+        }
+    }
 
     Serial.print("We are all set, follow the steps below to enroll a new finger");
 
@@ -262,8 +296,14 @@ void enrollFinger()
     }
 
     Serial.println(" >> Template created");
-    ret = fp->storeTemplate(1, location);
-    if (ret != R503_OK)
+    ret = autoLocation ? fp->storeNewTemplate(location) : fp->storeTemplateAt(location, overwrite);
+    if (ret == R503_DUPLICATE_FINGER)
+    {
+        Serial.printf("[X] This finger is already enrolled at location: %d\n", location);
+        fp->setAuraLED(aLEDFlash, aLEDRed, 50, 3);
+        return;
+    }
+    else if (ret != R503_OK)
     {
         Serial.printf("[X] Failed to store the template (code: 0x%02X)\n", ret);
         fp->setAuraLED(aLEDFlash, aLEDRed, 50, 3);
@@ -12,9 +12,21 @@
 #include <avr/io.h>
 #include <util/delay.h>
 #include <stdlib.h>
+#include <string.h>
+#include "hal.h"
+#include "adc.h"
+#include "knob.h"
+#include "keypad.h"
 #include "uart.h"
+#include "mcu_link.h"
+#include "timebase.h"
+#include "trace.h"
+#include "vault_fsm.h"
+#include "sched.h"
+#include "telemetry.h"
+#include "power.h"
 
-#define ADC_TOLERANCE 100  // Tolerance for ADC value matching
+#define PASSWORD_ALL 0x3F  // password_progress() with every control in position
 
 // PIN configuration
 #define PIN_LENGTH 4
@@ -29,46 +41,17 @@ typedef struct {
     uint8_t sw2_state;
 } Password;
 
-void adc_init(void) {
-    // Set PC0, PC1, PC2 as inputs
-    DDRC &= ~((1 << PC0) | (1 << PC1) | (1 << PC2));
-    
-    // Set reference voltage to AVCC
-    ADMUX = (1 << REFS0);
-    
-    // Enable ADC with prescaler of 128 (16MHz/128 = 125kHz)
-    ADCSRA = (1 << ADEN) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
-}
-
 void switch_init(void) {
     // Set PB2, PB3, PB4 as inputs
-    DDRB &= ~((1 << PB2) | (1 << PB3) | (1 << PB4));
+    hal_gpio_input(HAL_PORTB, (1 << PB2) | (1 << PB3) | (1 << PB4));
     
     // Enable internal pull-up resistors on PB2, PB3, PB4
-    PORTB |= (1 << PB2) | (1 << PB3) | (1 << PB4);
-}
-
-uint16_t adc_read(uint8_t channel) {
-    // Select ADC channel (0-2 for PC0-PC2)
-    // Clear lower 3 bits of ADMUX and set channel
-    ADMUX = (ADMUX & 0xF8) | (channel & 0x07);
-    
-    // Wait for the multiplexer to settle
-    _delay_us(10);
-    
-    // Start conversion
-    ADCSRA |= (1 << ADSC);
-    
-    // Wait for conversion to complete
-    while (ADCSRA & (1 << ADSC));
-    
-    // Return ADC value
-    return ADC;
+    hal_gpio_high(HAL_PORTB, (1 << PB2) | (1 << PB3) | (1 << PB4));
 }
 
 uint8_t switch_read(uint8_t pin) {
     // Read pin state (returns 0 if pressed/low, 1 if not pressed/high)
-    return (PINB & (1 << pin)) ? 1 : 0;
+    return (hal_gpio_read(HAL_PORTB) & (1 << pin)) ? 1 : 0;
 }
 
 void password_init(Password* pwd, uint16_t adc0, uint16_t adc1, uint16_t adc2,
@@ -81,373 +64,333 @@ void password_init(Password* pwd, uint16_t adc0, uint16_t adc1, uint16_t adc2,
     pwd->sw2_state = sw2;
 }
 
-uint8_t password_check(Password* pwd, uint16_t adc0, uint16_t adc1, uint16_t adc2,
-                       uint8_t sw0, uint8_t sw1, uint8_t sw2) {
-    // Check if switches match
-    if (sw0 != pwd->sw0_state || sw1 != pwd->sw1_state || sw2 != pwd->sw2_state) {
-        return 0;
-    }
+// Returns a bit per control in position: bit0-2 ADC0-2, bit3-5 SW0-2
+// knobs is knob_zones(), the filter already compared them with pwd's targets (see knob.h)
+uint8_t password_progress(Password* pwd, uint8_t knobs, uint8_t sw0, uint8_t sw1, uint8_t sw2) {
+    uint8_t progress = knobs & 0x07;
     
-    // Check if ADC values are within tolerance
-    if (abs(adc0 - pwd->adc0_target) > ADC_TOLERANCE) return 0;
-    if (abs(adc1 - pwd->adc1_target) > ADC_TOLERANCE) return 0;
-    if (abs(adc2 - pwd->adc2_target) > ADC_TOLERANCE) return 0;
+    // Check if switches match
+    if (sw0 == pwd->sw0_state) progress |= (1 << 3);
+    if (sw1 == pwd->sw1_state) progress |= (1 << 4);
+    if (sw2 == pwd->sw2_state) progress |= (1 << 5);
     
-    return 1;  // Password matches!
+    return progress;
 }
 
-// Keypad pins: Rows: PB1,PD2,PD3,PD4  Cols: PD5,PD6,PD7,PB0
-void keypad_init(void) {
-    // Configure columns as inputs with pullups
-    // Cols: PD5=COL1, PD6=COL2, PD7=COL3, PB0=COL4
-    DDRD &= ~((1 << PD5) | (1 << PD6) | (1 << PD7));
-    PORTD |= (1 << PD5) | (1 << PD6) | (1 << PD7);
-    
-    DDRB &= ~(1 << PB0);
-    PORTB |= (1 << PB0);
-    
-    // Configure rows as outputs driving HIGH
-    // Rows: PB1=ROW1, PD2=ROW2, PD3=ROW3, PD4=ROW4
-    DDRB |= (1 << PB1);
-    PORTB |= (1 << PB1);
-    
-    DDRD |= (1 << PD2) | (1 << PD3) | (1 << PD4);
-    PORTD |= (1 << PD2) | (1 << PD3) | (1 << PD4);
+uint8_t password_check(Password* pwd, uint8_t knobs, uint8_t sw0, uint8_t sw1, uint8_t sw2) {
+    // Password matches when all six controls are in position
+    return password_progress(pwd, knobs, sw0, sw1, sw2) == PASSWORD_ALL;
+}
+
+/*
+Messages to the LCD MCU (see mcu_link.h):
+STAGE   - new vault state (VAULT_* in vault_fsm.h), sent on every transition
+KNOBS   - combination progress (password_progress())
+DIGITS  - PIN digits entered, 0 after a reset
+*/
+uint8_t stage_seq = 0;      // last STAGE message, traced when the LCD MCU acknowledges it
+uint8_t stage_acked = 1;
+
+void talk_to_LCD(uint8_t type, uint8_t arg){ // SENDING TO LCD
+    uint8_t seq = mcu_link_send(type, arg);
+    if (type == MCU_MSG_STAGE){
+        stage_seq = seq;
+        stage_acked = 0;
+    }
+    telemetry_link(type, arg);
 }
 
-int keypad_read(void) {
-    // Scan rows by driving them low one at a time
-    // Row mapping: PB1=ROW1, PD2=ROW2, PD3=ROW3, PD4=ROW4
+// ========== VAULT STATE MACHINE ACTIONS (see vault_fsm.h) ==========
+Password myPassword;
+uint8_t correct_pin[PIN_LENGTH];
+uint8_t entered_pin[PIN_LENGTH];
+uint8_t pin_index = 0;
+uint8_t last_progress = 0;
+uint8_t controls_changed = 0;   // a knob changed zone or a switch flipped since the last combination check
+
+// knob filter events (knob.h): the combination is only re-checked when one of these comes in
+void knob_event(uint8_t knob, uint8_t entered, uint16_t dwell_ms){
+    telemetry_zone(knob, entered, dwell_ms);
+    controls_changed = 1;
+}
+
+void action_start(uint8_t identity){
+    trace_mark(TRACE_KEYPAD_IDENTITY, identity);
+
+    // Initialize peripherals
+    adc_init();
+    switch_init();
+    keypad_init();
+
+    // Create password format: ADC0, ADC1, ADC2, SW0, SW1, SW2
+    if (identity == 1){ // JEEVAN'S PASSWORD
+        password_init(&myPassword, 512, 768, 256, 0, 1, 0);
     
-    for (int row = 0; row < 4; row++) {
-        // Set all rows HIGH first
-        PORTB |= (1 << PB1);
-        PORTD |= (1 << PD2) | (1 << PD3) | (1 << PD4);
-        
-        // Drive current row LOW based on which row we're scanning
-        if (row == 0) PORTB &= ~(1 << PB1);  // ROW1
-        else if (row == 1) PORTD &= ~(1 << PD2);  // ROW2
-        else if (row == 2) PORTD &= ~(1 << PD3);  // ROW3
-        else if (row == 3) PORTD &= ~(1 << PD4);  // ROW4
-        
-        _delay_us(10);  // Small delay for signal to settle
-        
-        // Read columns (active low with pullups)
-        unsigned char col1 = (PIND & (1 << PD5)) ? 0 : 1;  // COL1
-        unsigned char col2 = (PIND & (1 << PD6)) ? 0 : 1;  // COL2
-        unsigned char col3 = (PIND & (1 << PD7)) ? 0 : 1;  // COL3
-        unsigned char col4 = (PINB & (1 << PB0)) ? 0 : 1;  // COL4
-        
-        // Check which column is pressed
-        if (col1 || col2 || col3 || col4) {
-            // Return all rows to HIGH
-            PORTB |= (1 << PB1);
-            PORTD |= (1 << PD2) | (1 << PD3) | (1 << PD4);
-            
-            // Map row index to physical row
-            // We scan PB1,PD2,PD3,PD4 in order (row 0-3)
-            // These correspond to physical ROW1-4 directly
-            int physical_row = row;
-            
-            // Keypad layout mapping
-            //      COL1  COL2  COL3  COL4
-            // ROW1:  1     2     3     A (10)
-            // ROW2:  4     5     6     B (11)
-            // ROW3:  7     8     9     C (12)
-            // ROW4:  *     0     #     D (13)
-            
-            if (physical_row == 0 && col1) return 1;
-            if (physical_row == 0 && col2) return 2;
-            if (physical_row == 0 && col3) return 3;
-            if (physical_row == 0 && col4) return 10;  // A
-            
-            if (physical_row == 1 && col1) return 4;
-            if (physical_row == 1 && col2) return 5;
-            if (physical_row == 1 && col3) return 6;
-            if (physical_row == 1 && col4) return 11;  // B
-            
-            if (physical_row == 2 && col1) return 7;
-            if (physical_row == 2 && col2) return 8;
-            if (physical_row == 2 && col3) return 9;
-            if (physical_row == 2 && col4) return 12;  // C
-            
-            if (physical_row == 3 && col1) return 14;  // *
-            if (physical_row == 3 && col2) return 0;
-            if (physical_row == 3 && col3) return 15;  // #
-            if (physical_row == 3 && col4) return 13;  // D
-        }
+        correct_pin[0] = 6;
+        correct_pin[1] = 9;
+        correct_pin[2] = 6;
+        correct_pin[3] = 9;
     }
+    if (identity == 2){ // YONGWOO'S PASSWORD
+        password_init(&myPassword, 512, 768, 256, 0, 1, 0);
     
-    // Return all rows to HIGH
-    PORTB |= (1 << PB1);
-    PORTD |= (1 << PD2) | (1 << PD3) | (1 << PD4);
+        correct_pin[0] = 1;
+        correct_pin[1] = 2;
+        correct_pin[2] = 3;
+        correct_pin[3] = 4;
+    }
+    if (identity == 3){ // TOMAS' PASSWORD
+        password_init(&myPassword, 512, 768, 256, 0, 1, 0);
     
-    return -1;  // No key pressed
+        correct_pin[0] = 1;
+        correct_pin[1] = 2;
+        correct_pin[2] = 3;
+        correct_pin[3] = 4;
+    }
+    uint16_t targets[KNOB_COUNT] = {myPassword.adc0_target, myPassword.adc1_target, myPassword.adc2_target};
+    knob_init(targets, knob_event);
+    last_progress = 0;
+    controls_changed = 1;
 }
 
-void setup_inputs(void)
-{
-    // Set PC3, PC4, PC5 as inputs
-    DDRC &= ~((1 << PC3) | (1 << PC4) | (1 << PC5));
-    
-    // Disable pull-ups (optional)
-    PORTC &= ~((1 << PC3) | (1 << PC4) | (1 << PC5));
+void action_combination(uint8_t arg){
+    // Conditions lost, reset everything
+    last_progress = 0;
+    controls_changed = 1;   // show the LCD which controls are still in position
+    pin_index = 0;
 }
 
-// function that checks state of progress from other MCU
-uint8_t read_inputs(void)
-{
-    uint8_t pin_state = PINC;  // Read entire port once (best practice)
-
-    uint8_t BIT0_high     = (pin_state & (1 << PC3))     != 0;
-    uint8_t BIT1_check_high = (pin_state & (1 << PC4)) != 0;
-    uint8_t BIT2_check_high = (pin_state & (1 << PC5)) != 0;
+void action_pin(uint8_t arg){
+    trace_mark(TRACE_KEYPAD_COMBINATION, 0);
+    pin_index = 0; // Reset PIN entry
+}
 
-    // For debugging:
-    // if (comms_high)     uart_tx("COMMS HIGH\n");
-    // if (pin_check_high) uart_tx("PIN HIGH\n");
+void action_wrong_pin(uint8_t arg){
+    trace_mark(TRACE_KEYPAD_PIN, 0);
+    pin_index = 0;
+}
 
-    // You can return a bitmask or handle individually
-    return (BIT2_check_high << 2) | (BIT1_check_high << 1) | (BIT0_high);
+void action_unlock(uint8_t arg){
+    trace_mark(TRACE_KEYPAD_PIN, 1);
 }
 
-void comms_output_init(void){
-    // Setup output communicators (PC3, PC4, PC5)
-    DDRC |= (1 << PC3) | (1 << PC4) | (1 << PC5);
-    PORTC &= ~((1 << PC3) | (1 << PC4) | (1 << PC5)); // Turn off communicators, state 0
+void action_lock(uint8_t arg){
+    trace_mark(TRACE_KEYPAD_LOCK, 0);
 }
 
-/*
-0 - ADC wrong
-1 - ADC correct
-2 - wait for pin value
-3 - pin value entered
-4 - pin restart
-5 - wrong
-6 - correct
-7 - LOCK/RESET
-*/
-void talk_to_LCD(uint8_t state){ // PC3 = bit0, PC4 = bit1, PC5 = bit2. Parallel 3 bit comms. SENDING TO LCD
-    // Clear PC3, PC4, PC5
-    PORTC &= ~((1 << PC3) | (1 << PC4) | (1 << PC5));
+const vault_action_t keypad_actions[VAULT_ACTION_COUNT] = {
+    [VAULT_ACT_START] = action_start,
+    [VAULT_ACT_COMBINATION] = action_combination,
+    [VAULT_ACT_PIN] = action_pin,
+    [VAULT_ACT_WRONG_PIN] = action_wrong_pin,
+    [VAULT_ACT_RETRY] = action_wrong_pin,   // PIN entry already reset, the LCD redraws
+    [VAULT_ACT_UNLOCK] = action_unlock,
+    [VAULT_ACT_LOCK] = action_lock,
+};
 
-    // Mask state to 3 bits (0–7) and shift into PC3–PC5
-    PORTC |= (state & 0x07) << PC3;
-    printf("State:%u \r\n",state);
-}
+vault_fsm_t vault;
 
-int main(void) {
-    // Initialize UART
-    uart_init();
+// runs an event through the shared table and tells the LCD MCU about the new state
+void vault_event(uint8_t event, uint8_t arg){
+    uint8_t from = vault.state;
     
-    while (1) {
-        // ========== IDENTITY VERIFICATION PHASE ==========
-        
-        uint8_t identity_verified = 0;
-        uint8_t state = 8;
-        
-        while (!identity_verified){
-            setup_inputs(); // PC3, PC4, PC5 as inputs
-            state = read_inputs();
-            printf("waiting for identity\r\n");
-            if (state == 1){
-                identity_verified = 1;
-                printf("identity confirmed: jeevan\r\n");
-            }
-            if (state == 2){
-                identity_verified = 1;
-                printf("identity confirmed: yongwoo\r\n");
-            }
-            if (state == 3){
-                identity_verified = 1;
-                printf("identity confirmed: tomas\r\n");
-            }
-        }
-        
-        // ========== INITIALIZE SECURITY SYSTEM ==========
-        // Initialize peripherals
-        adc_init();
-        switch_init();
-        keypad_init();
-        
-        // Setup output communicators (PC3, PC4, PC5)
-        comms_output_init();
-        _delay_ms(4000); // delay while screen initializes opening state
-        
-        // Create password format: ADC0, ADC1, ADC2, SW0, SW1, SW2
-        Password myPassword;
-        // Pin created in if statements
-        uint8_t correct_pin[PIN_LENGTH];
-        
-        if (state == 1){ // JEEVAN'S PASSWORD
-            password_init(&myPassword, 512, 768, 256, 0, 1, 0);
-        
-            correct_pin[0] = 6;
-            correct_pin[1] = 9;
-            correct_pin[2] = 6;
-            correct_pin[3] = 9;
-        }
-        if (state == 2){ // YONGWOO'S PASSWORD
-            password_init(&myPassword, 512, 768, 256, 0, 1, 0);
-        
-            correct_pin[0] = 1;
-            correct_pin[1] = 2;
-            correct_pin[2] = 3;
-            correct_pin[3] = 4;
-        }
-        if (state == 3){ // TOMAS' PASSWORD
-            password_init(&myPassword, 512, 768, 256, 0, 1, 0);
-        
-            correct_pin[0] = 1;
-            correct_pin[1] = 2;
-            correct_pin[2] = 3;
-            correct_pin[3] = 4;
-        }
+    if (vault_fsm_dispatch(&vault, event, arg, timebase_ms())) {
+        telemetry_state(from, event, vault.state, arg);
+        talk_to_LCD(MCU_MSG_STAGE, vault.state);
+    }
+}
 
-        
-        printf("Security System Initialized!\r\n");
-        printf("Target: ADC0=%u, ADC1=%u, ADC2=%u, SW0=%s, SW1=%s, SW2=%s\r\n\r\n",
-               myPassword.adc0_target, myPassword.adc1_target, myPassword.adc2_target,
-               myPassword.sw0_state ? "HIGH" : "LOW",
-               myPassword.sw1_state ? "HIGH" : "LOW",
-               myPassword.sw2_state ? "HIGH" : "LOW");
-        
-        uint8_t entered_pin[PIN_LENGTH];
-        uint8_t pin_index = 0;
-        uint8_t conditions_met = 0;
-        uint8_t pin_verified = 0;
-        int last_key = -1;
-        uint16_t adc0, adc1, adc2;
-        uint8_t sw0, sw1, sw2;
-        
-        // ========== SECURITY CHECK LOOP ==========
-        while (identity_verified) {
-            // Read ADC and switch values
-            adc0 = adc_read(0);  // PC0
-            adc1 = adc_read(1);  // PC1
-            adc2 = adc_read(2);  // PC2
-            sw0 = switch_read(PB2);
-            sw1 = switch_read(PB3);
-            sw2 = switch_read(PB4);
-            
-            // Stage 1: Check ADC and switch conditions
-            if (!conditions_met) {
-                // Print current values
-                printf("Current: ADC0=%4u, ADC1=%4u, ADC2=%4u | SW0=%s, SW1=%s, SW2=%s",
-                       adc0, adc1, adc2,
-                       sw0 ? "HIGH" : "LOW",
-                       sw1 ? "HIGH" : "LOW",
-                       sw2 ? "HIGH" : "LOW");
-                
-                // Check if password conditions are met
-                if (password_check(&myPassword, adc0, adc1, adc2, sw0, sw1, sw2)) {
-                    talk_to_LCD(1);
-                    conditions_met = 1;
-                    pin_index = 0; // Reset PIN entry
-                    printf(" -> *** STAGE 1 PASSED! LED1 ON ***\r\n");
-                    _delay_ms(1500);
-                } else {
-                    talk_to_LCD(0);
-                    printf(" -> Access Denied\r\n");
-                }
-            }
-            
-            // Stage 2: PIN entry (only if conditions are met and PIN not yet verified)
-            if (conditions_met && !pin_verified) {
-                talk_to_LCD(2);
-                // Continuously check if ADC/switch conditions are still valid
-                if (!password_check(&myPassword, adc0, adc1, adc2, sw0, sw1, sw2)) {
-                    // Conditions lost, reset everything
-                    talk_to_LCD(0);
-                    conditions_met = 0;
-                    pin_verified = 0;
-                    pin_index = 0;
-                    last_key = -1;
-                    printf("*** CONDITIONS LOST! SYSTEM RESET ***\r\n\r\n");
-                    continue;
-                }
-                
-                int key = keypad_read();
-                
-                // Only process key if it's different from last reading (debounce)
-                if (key != -1 && key != last_key) {
-                    // Handle special keys
-                    if (key == 14) {  // * key - reset
-                        talk_to_LCD(4);
-                        pin_index = 0;
-                        printf("PIN entry reset.\r\n");
-                    }
-                    else if (key == 15) {  // # key - enter
-                        if (pin_index == PIN_LENGTH) {
-                            uint8_t match = 1;
-                            for (uint8_t i = 0; i < PIN_LENGTH; i++) {
-                                if (entered_pin[i] != correct_pin[i]) {
-                                    match = 0;
-                                    break;
-                                }
-                            }
-                            
-                            if (match) {
-                                talk_to_LCD(6);
-                                pin_verified = 1;
-                                printf("*** PIN CORRECT! STAGE 2 PASSED! LED2 ON ***\r\n");
-                                printf("*** FULL ACCESS GRANTED! ***\r\n\r\n");
-                            } else {
-                                // Wrong PIN, reset entry and blink
-                                printf("Wrong PIN! Try again.\r\n");
-                                pin_index = 0;
-                                talk_to_LCD(5);
-                                _delay_ms(5000);
-                                talk_to_LCD(4);
-                                _delay_ms(100);
-                            }
-                        } else {
-                            // Not enough digits entered, reset
-                            printf("Incomplete PIN (only %u digits). Resetting.\r\n", pin_index);
-                            talk_to_LCD(4);
-                            pin_index = 0;
-                        }
-                    }
-                    else if (key >= 0 && key <= 9) {  // Regular digit (0-9)
-                        if (pin_index < PIN_LENGTH) {
-                            entered_pin[pin_index] = key;
-                            pin_index++;
-                            printf("Key pressed: %u (Total: %u/%u)\r\n", key, pin_index, PIN_LENGTH);
-                            talk_to_LCD(3);
-                            _delay_ms(100);
-                        }
-                    }
+// PIN entry: digits, * to clear, # to check
+void handle_pin_key(uint8_t key){
+    if (key == KEYPAD_KEY_STAR) {  // * key - reset
+        talk_to_LCD(MCU_MSG_DIGITS, 0);
+        pin_index = 0;
+    }
+    else if (key == KEYPAD_KEY_HASH) {  // # key - enter
+        if (pin_index == PIN_LENGTH) {
+            uint8_t match = 1;
+            for (uint8_t i = 0; i < PIN_LENGTH; i++) {
+                if (entered_pin[i] != correct_pin[i]) {
+                    match = 0;
+                    break;
                 }
-                last_key = key;
             }
-            
-            // Stage 3: System is unlocked - wait for lock command
-            if (pin_verified) {
-                int key = keypad_read();
+            vault_event(match ? VAULT_EV_PIN_OK : VAULT_EV_PIN_WRONG, 0);
+        } else {
+            // Not enough digits entered, reset
+            talk_to_LCD(MCU_MSG_DIGITS, 0);
+            pin_index = 0;
+        }
+    }
+    else if (key <= 9) {  // Regular digit (0-9)
+        if (pin_index < PIN_LENGTH) {
+            entered_pin[pin_index] = key;
+            pin_index++;
+            trace_mark(TRACE_KEYPAD_DIGIT, pin_index);
+            talk_to_LCD(MCU_MSG_DIGITS, pin_index);
+        }
+    }
+}
 
-                if (key != -1 && key != last_key) {
-                    // If * (Key 14) is pressed while unlocked
-                    if (key == 14) {
-                        printf("Locking System...\r\n");
+// ========== TASKS (see sched.h) ==========
+#define SAMPLE_MS 10    // knobs and switches
+#define KEYS_MS 10      // keypad events, debounced by the keypad.c scanner
+#define CONSOLE_MS 20
+#define IDLE_MS 5000    // locked and quiet this long: power down between events (see power_down_ready())
+#ifndef POWER_DOWN
+#define POWER_DOWN 1    // 0 stays in idle mode, e.g. to use the console while locked
+#endif
 
-                        // Send State 7 (LOCK)
-                        talk_to_LCD(7);
+uint16_t adc0, adc1, adc2;
+uint8_t sw0, sw1, sw2;
+uint8_t switches = 0;   // bit0-2 SW0-2
+uint8_t progress = 0;   // latest password_progress()
 
-                        _delay_ms(2000); // wait for servo to close
+// messages from the LCD MCU, acknowledgements and the state timeouts, on every pass
+void link_task(void){
+    mcu_msg_t msg;
+    
+    if (mcu_link_poll(&msg)) {
+        power_activity();
+        if (msg.type == MCU_MSG_IDENTITY && msg.arg >= 1 && msg.arg <= 3)
+            vault_event(VAULT_EV_IDENTITY, msg.arg);
+    }
+    
+    // the LCD MCU acknowledges a stage once it has acted on it (screen drawn, box closed)
+    if (!stage_acked && mcu_link_acked(stage_seq)) {
+        stage_acked = 1;
+        trace_mark(TRACE_KEYPAD_ACK, MCU_MSG_STAGE);
+        if (vault.state == VAULT_LOCKED) {
+            trace_dump();
+        }
+    }
+    
+    // "Incorrect PIN" timeout
+    uint8_t from = vault.state;
+    if (vault_fsm_poll(&vault, timebase_ms())) {
+        telemetry_state(from, VAULT_EV_TIMEOUT, vault.state, 0);
+        talk_to_LCD(MCU_MSG_STAGE, vault.state);
+    }
+}
 
-                        // Reset identity_verified to break out and restart identity verification
-                        identity_verified = 0;
-                    }
-                }
-                last_key = key;
-            }
-            
-            _delay_ms(50); // Debounce delay
+// Stage 1 and the combination check that guards stage 2
+void sample_task(void){
+    if (vault.state == VAULT_LOCKED)
+        return;
+    
+    // knobs from the last ADC round, the next one runs in the background until the next pass
+    uint16_t adc[ADC_CHANNELS];
+    uint8_t sampled = adc_latest(adc);
+    adc_start();
+    if (!sampled)
+        return;
+    adc0 = adc[0];  // PC0
+    adc1 = adc[1];  // PC1
+    adc2 = adc[2];  // PC2
+    sw0 = switch_read(PB2);
+    sw1 = switch_read(PB3);
+    sw2 = switch_read(PB4);
+    uint8_t switches_now = sw0 | (sw1 << 1) | (sw2 << 2);
+    telemetry_adc(adc0, adc1, adc2, switches_now);
+    
+    knob_update(adc, timebase_ms());    // calls knob_event() on a zone change
+    if (switches_now != switches) {
+        switches = switches_now;
+        controls_changed = 1;
+    }
+    if (!controls_changed)
+        return;
+    controls_changed = 0;
+    power_activity();
+    progress = password_progress(&myPassword, knob_zones(), sw0, sw1, sw2);
+    
+    if (vault.state == VAULT_COMBINATION) {
+        if (progress == PASSWORD_ALL) {
+            vault_event(VAULT_EV_COMBINATION_OK, 0);
+        } else if (progress != last_progress) {
+            talk_to_LCD(MCU_MSG_KNOBS, progress);
+            last_progress = progress;
         }
-        
-        // System has been locked, loop will restart identity verification
-        printf("*** SYSTEM LOCKED - RESTARTING IDENTITY VERIFICATION ***\r\n\r\n");
     }
+    // the ADC/switch conditions must stay valid throughout PIN entry
+    else if ((vault.state == VAULT_PIN || vault.state == VAULT_WRONG_PIN) && progress != PASSWORD_ALL) {
+        vault_event(VAULT_EV_COMBINATION_LOST, 0);
+    }
+}
+
+// Stage 2 PIN entry and stage 3 lock key
+void keypad_task(void){
+    keypad_event_t event;
+    
+    while (keypad_get(&event)) {
+        power_activity();
+        // a held key repeats, but a PIN digit must be pressed again to count twice
+        if (event.type != KEYPAD_PRESS)
+            continue;
+        if (vault.state == VAULT_LOCKED)
+            continue;
+        telemetry_key((event.key <= 9) ? TELEM_KEY_DIGIT : event.key, pin_index);
+        if (vault.state == VAULT_PIN)
+            handle_pin_key(event.key);
+        // If * is pressed while unlocked
+        else if (vault.state == VAULT_UNLOCKED && event.key == KEYPAD_KEY_STAR)
+            vault_event(VAULT_EV_LOCK, 0);
+    }
+}
+
+// service console on the USB serial adapter: "status" or "stats", one command per line
+void console_task(void){
+    char command[8];
+    
+    if (uart_try_scanf("%7s", command) != 1)
+        return;
+    power_activity();
+    if (!strcmp(command, "status")) {
+        printf("state %u, controls %02X, PIN digits %u\r\n", vault.state, progress, pin_index);
+    } else if (!strcmp(command, "stats")) {
+        printf("uart dropped %u rx overruns %u peak %u | link crc %u dropped %u | sched late %u | keys dropped %u"
+               " | power-downs %u\r\n",
+               uart_tx_dropped, uart_rx_overruns, uart_tx_peak, mcu_link_crc_errors, mcu_link_dropped, sched_late,
+               keypad_dropped, power_downs);
+    } else {
+        printf("commands: status, stats\r\n");
+    }
+}
+
+/*
+Power-down (power.h) stops the timebase, the ADC, USART0 and the keypad timer, so it is only allowed while locked
+with nothing in flight: the LCD MCU has acknowledged the LOCKED stage, the link and the UART are drained, and no
+ADC round, key scan or trace dump is running. The IDENTITY message then wakes it by TWI address match (the TWI
+holds SCL low until the MCU is up, so the frame is not lost), and a key press by pin change once the keypad has
+been used.
+USART0 input does not wake it, so console commands typed while it is powered down are lost.
+*/
+uint8_t power_down_ready(void){
+    return POWER_DOWN && vault.state == VAULT_LOCKED && stage_acked && !mcu_link_busy() && !trace_busy() &&
+           !uart_tx_busy() && !adc_busy() && keypad_idle();
+}
+
+int main(void) {
+    // Initialize UART
+    uart_init();
+    timebase_init();
+    mcu_link_init(MCU_LINK_ADDR_KEYPAD, MCU_LINK_ADDR_LCD);
+    trace_init("keypad", uart_try_send);
+    trace_sync_listen(); // PC3 from the LCD MCU
+    vault_fsm_init(&vault, keypad_actions, timebase_ms());
+    
+    sched_init();
+    sched_every(link_task, 0);
+    sched_every(sample_task, SAMPLE_MS);
+    sched_every(keypad_task, KEYS_MS);
+    sched_every(console_task, CONSOLE_MS);
+    power_init(IDLE_MS, IDLE_MS, 0, power_down_ready);
+    
+    printf("waiting for identity\r\n");
+    
+    // everything runs in the tasks, sleeping in between
+    while (1)
+        sched_run();
     
     return 0;
-}
\ No newline at end of file
+}
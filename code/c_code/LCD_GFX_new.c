@@ -21,7 +21,7 @@ uint16_t rgb565(uint8_t red, uint8_t green, uint8_t blue){
 // fucntion to draw pixel to the given x y coordinate:
 void draw_pixel(uint8_t x, uint8_t y, uint16_t color){
     LCD_setAddress(x, y, x, y);     // set window to only one pixel
-    LCD_PORT |= (1<<LCD_DC); // data mode
+    hal_gpio_high(LCD_PORT, (1<<LCD_DC)); // data mode
     SPI_controllerTx(color);        // send color to pixel
 }
 
@@ -32,7 +32,7 @@ void draw_char(uint8_t x0, uint8_t y0, uint16_t character, uint16_t f_c, uint16_
 	if ((LCD_WIDTH - x0 > 6)&&(LCD_HEIGHT - y0 > 7)){	
 		// set window for the entire 6x8 character block *one time*
         LCD_setAddress(x0, y0, x0 + 5, y0 + 7);
-        LCD_PORT |= (1<<LCD_DC); // data mode
+        hal_gpio_high(LCD_PORT, (1<<LCD_DC)); // data mode
 
 		// loop through each row of the 8-row character
         for (uint8_t j = 0; j < 8; j++){
@@ -46,7 +46,7 @@ void draw_char(uint8_t x0, uint8_t y0, uint16_t character, uint16_t f_c, uint16_
             // add 1 column of background color as spacing between characters
             SPI_controllerTx(b_c);
         }
-		LCD_PORT |= (1 << LCD_TFT_CS);
+		hal_gpio_high(LCD_PORT, (1 << LCD_TFT_CS));
     }
 }
 
@@ -173,7 +173,7 @@ void LCD_drawLine(short x0,short y0,short x1,short y1,uint16_t c)
 void LCD_drawBlock(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1,uint16_t color)
 {
 	LCD_setAddress(x0,y0,x1,y1);
-    LCD_PORT |= (1<<LCD_DC); // data mode
+    hal_gpio_high(LCD_PORT, (1<<LCD_DC)); // data mode
 	for(int i = 0; i < (x1-x0+1)*(y1-y0+1); i++){
 		SPI_controllerTx(color);
 	}
@@ -183,7 +183,7 @@ void LCD_drawBlock(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1,uint16_t color
 void LCD_setScreen(uint16_t color) 
 {
 	LCD_setAddress(0,0,159,127);
-    LCD_PORT |= (1<<LCD_DC); // data mode
+    hal_gpio_high(LCD_PORT, (1<<LCD_DC)); // data mode
 	for(int i = 0; i < 160*128; i++){
 		SPI_controllerTx(color);
 	}
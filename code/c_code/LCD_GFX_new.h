@@ -2,7 +2,7 @@
 Header file for graphic controls
 */
 
-#include <avr/io.h>
+#include "hal.h"
 #include "ASCII_LUT.h"
 // #include "ASCII_LUT_10x16.h"
 
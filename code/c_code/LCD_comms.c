@@ -5,28 +5,37 @@
 #include "ST7735_new.h"
 #include "LCD_GFX_new.h"
 #include "uart.h"
-#include <avr/interrupt.h>
-
-#define BIT0    PC3   // PC4 input
-#define BIT2    PC5   // PC5 input
-#define BIT1    PC4   // PC3 input
-#define SERVO   PD2   // servo PWM
+#include "vault_link.h"
+#include "mcu_link.h"
+#include "timebase.h"
+#include "trace.h"
+#include "vault_fsm.h"
+#include "sched.h"
+#include "servo.h"
+#include "motor.h"
+#include "power.h"
 
-#define FINGER0 PC1   // Fingerprint check pin
-#define FINGER1 PC2   // Fingerprint check pin
 #define FINGER_OUT PC0 // fingerprint reset line
 
-// motor pins:
-#define IN1 PD3     // H-bridge pin 2 (IN1)
-#define IN2 PD4     // H-bridge pin 7 (IN2)
-#define PWM PD5     // PWM for speed control
+// actuator timings
+#define RESET_PULSE_MS 500  // fingerprint reset line
+#define LATCH_MS 1000       // servo travel
+#define LATCH_RAMP_MS 600   // servo ramp, within LATCH_MS
+#define ACCEPTED_MS 1000    // "Combination Accepted" before the PIN screen
+
+// power levels (see power.h), timed from the last message, finger or movement
+#define DIM_MS 20000        // backlight dimmed, panel in idle mode
+#define OFF_MS 60000        // backlight off, panel asleep
+#define BACKLIGHT_DIM 20    // duty cycle while dimmed, LCD_BACKLIGHT otherwise
+
+// sliding door travel: the same push as the old 500 ms at full drive, with 80 ms ramps at each end
+static const motor_profile_t door_profile = {255, 80, 560, 80};
 
 // parameters for servo controls
-volatile uint16_t servo_pulse_ticks = 150;  // default = 1.5ms
-volatile uint16_t tick_counter = 0;
 volatile uint8_t open = 120;    // open latch in degrees
 volatile uint8_t closed = 0;    // closed latch in degrees
 volatile uint8_t fingerprint_read = 0;
+uint8_t sync_count = 0;         // reset line pulses sent, tags TRACE_SYNC
 
 // ---------------------------------- MCU Pinout -------------------------------------------
 /*
@@ -39,12 +48,12 @@ LCD:
 - PD6 --> LCD_LITE
 
 SERVO:
-- PD2 --> servo PWM (orange)
+- PD2 --> servo PWM (orange, OC4B, see servo.h)
 - 5V rail --> servo power (red)
 - GND --> GND (brown)
 
 H-Drive + DC motor:
-- PD3 --> IN1 (pin 2)
+- PD3 --> IN1 (pin 2, OC2B PWM, see motor.h)
 - PD4 --> IN2 (pin 7)
 - 5V rail --> 1,2 EN (pin 1)
 - 5V rail --> Vcc1 (pin 16)
@@ -53,461 +62,521 @@ H-Drive + DC motor:
 - 2Y (pin 6) --> motor -
 - Buck 6V --> Vcc2 (pin 8)
 
-Other ATmega MCU:
-- PC3 --> PC3 (bit0)
-- PC4 --> PC4 (bit1)
-- PC5 --> PC5 (bit2)
+Other ATmega MCU (TWI message link, see mcu_link.h):
+- PC4 <--> PC4 (SDA)
+- PC5 <--> PC5 (SCL)
+- PC3 --> PC3 (trace sync, pulsed with the reset line)
+
+ESP32 (fingerprint):
+- PD0 (RXD0) <-- GPIO10 (framed identity link, see vault_link.h)
+- PC0 --> GPIO7 (reset line, also the trace sync pulse)
+- PD1 (TXD0) --> USB serial adapter for trace dumps (optional)
 */
 
 
-void setup_inputs(void)
+void setup_outputs(void)
 {
-    // Set PC2, PC3, PC4, PC5 as inputs
-    DDRC &= ~((1 << BIT0) | (1 << BIT1) | (1 << BIT2) | (1 << FINGER0) | (1 << FINGER1));
-    
-    // Disable pull-ups 
-    PORTC &= ~((1 << BIT0) | (1 << BIT1) | (1 << BIT2) | (1 << FINGER0) | (1 << FINGER1));
+    // fingerprint reset line and trace sync line as outputs, low
+    DDRC |= (1 << FINGER_OUT) | (1 << TRACE_SYNC_PIN);
+    PORTC &= ~((1 << FINGER_OUT) | (1 << TRACE_SYNC_PIN));
 }
 
-void setup_outputs(void)
+// resets the fingerprint side (held for RESET_PULSE_MS); both lines rise on the same clock, so the ESP32 and the
+// keypad MCU timestamp the same instant as this MCU's TRACE_SYNC
+void reset_line_raise(void)
 {
-    // Set PC3, PC4, PC5 as outputs
-    DDRC |= ((1 << BIT0) | (1 << BIT1) | (1 << BIT2) | (1 << FINGER_OUT));
-    
-    // Disable pull-ups 
-    PORTC &= ~((1 << BIT0) | (1 << BIT1) | (1 << BIT2) | (1 << FINGER_OUT));
+    PORTC |= (1 << FINGER_OUT) | (1 << TRACE_SYNC_PIN);
+    trace_mark(TRACE_SYNC, sync_count++);
 }
 
-void motor_init(void)
+void reset_line_release(void)
 {
-    // Motor pins output
-    // DDRD |= (1<<IN1) | (1<<IN2) | (1<<PWM);
-    DDRD |= (1<<IN1) | (1<<IN2);
+    PORTC &= ~((1 << FINGER_OUT) | (1 << TRACE_SYNC_PIN));
+}
 
-    // // PWM initialization:
-    // TCCR0A = (1<<WGM00) | (1<<WGM01);   // fast PWM mode
-    // TCCR0A |= (1<<COM0B1);              // non-inverting PWM
-    // TCCR0B = (1<<CS01);                 // /8 clock prescaler 
-    // OCR0B = 0;                          // set compare register to 0 to start (0 speed)
+// ------------------------------------ MCU COMMUNICATION -------------------------------------------------
 
-    // // ADC initialization:
-    // ADMUX = (1<<REFS0);         // set 5V as reference voltage
-    // ADCSRA = (1<<ADEN) | 7;     // enable ADC and set prescaler to /128 (ADPS2 = 1, ADPS1 = 1, ADPS0 = 1)
+void talk_to_MCU(uint8_t type, uint8_t arg){ // SENDING TO KEYPAD MCU, see mcu_link.h for the message types
+    mcu_link_send(type, arg);
+    //printf("Message:%u %u \r\n", type, arg);
 }
 
-void servo_init(void)
+
+// ------------------------------------ SCREENS -------------------------------------------------
+/*
+Screens are painted a piece at a time by render_task(): one 8-row band of background or one character per pass,
+so messages keep being handled while a screen is still going up. render_show() restarts painting with a new
+screen; the knob/PIN progress overlays are drawn last and redrawn on their own when they change.
+*/
+#define RENDER_BAND_ROWS 8      // 160x8 pixels, about 3 ms of SPI
+#define RENDER_BANDS (LCD_HEIGHT / RENDER_BAND_ROWS)
+
+#define OVERLAY_NONE 0
+#define OVERLAY_KNOBS 1     // "Set: n/6"
+#define OVERLAY_DIGITS 2    // PIN positions
+
+typedef struct {
+    uint8_t x;
+    uint8_t y;
+    char *text;
+    uint16_t fg;
+} label_t;
+
+typedef struct {
+    uint16_t bg;
+    uint8_t overlay;
+    uint8_t count;
+    const label_t *labels;
+} screen_t;
+
+#define SCREEN(bg, overlay, labels) {bg, overlay, sizeof(labels) / sizeof(labels[0]), labels}
+
+static const label_t locked_labels[] = {{20, 50, "System Locked", RED}};
+static const label_t fingerprint_labels[] = {{15, 50, "Waiting for Fingerprint", BLUE}};
+static const label_t yongwoo_labels[] = {{20, 50, "Welcome, Yongwoo", BLUE}};
+static const label_t jeevan_labels[] = {{20, 50, "Welcome, Jeevan", BLUE}};
+static const label_t tomas_labels[] = {{20, 50, "Welcome, Tomas", BLUE}};
+static const label_t combination_labels[] = {{29, 50, "Enter Combination", BLUE}};
+static const label_t accepted_labels[] = {{20, 50, "Combination Accepted", BLUE}};
+static const label_t pin_labels[] = {{20, 45, "Enter PIN:", BLUE}, {20, 55, "# to finish", BLUE}};
+static const label_t wrong_pin_labels[] = {{41, 60, "Incorrect PIN", WHITE}, {41, 80, "Press * to retry", WHITE}};
+static const label_t pin_ok_labels[] = {{44, 60, "PIN accepted", WHITE}};
+static const label_t unlocked_labels[] = {{20, 50, "UNLOCKED", WHITE}, {20, 70, "Press * to Lock", WHITE}};
+static const label_t locking_labels[] = {{20, 50, "LOCKING SYSTEM...", WHITE}};
+
+static const screen_t screen_locked = SCREEN(WHITE, OVERLAY_NONE, locked_labels);
+static const screen_t screen_fingerprint = SCREEN(WHITE, OVERLAY_NONE, fingerprint_labels);
+static const screen_t screen_combination = SCREEN(WHITE, OVERLAY_KNOBS, combination_labels);
+static const screen_t screen_accepted = SCREEN(WHITE, OVERLAY_NONE, accepted_labels);
+static const screen_t screen_pin = SCREEN(WHITE, OVERLAY_DIGITS, pin_labels);
+static const screen_t screen_wrong_pin = SCREEN(RED, OVERLAY_NONE, wrong_pin_labels);
+static const screen_t screen_pin_ok = SCREEN(GREEN, OVERLAY_NONE, pin_ok_labels);
+static const screen_t screen_unlocked = SCREEN(GREEN, OVERLAY_NONE, unlocked_labels);
+static const screen_t screen_locking = SCREEN(RED, OVERLAY_NONE, locking_labels);
+
+// R503 template ID -> identity code sent to the other MCU (1 = Jeevan, 2 = Yongwoo, 3 = Tomas), and its greeting
+static const uint8_t identity_codes[] = {2, 1, 3};
+static const screen_t identity_greetings[] = {
+    SCREEN(WHITE, OVERLAY_NONE, yongwoo_labels),
+    SCREEN(WHITE, OVERLAY_NONE, jeevan_labels),
+    SCREEN(WHITE, OVERLAY_NONE, tomas_labels),
+};
+
+static const screen_t *screen = 0;     // being painted or on display
+static uint8_t render_band = RENDER_BANDS;
+static uint8_t render_label = 0;
+static uint8_t render_char = 0;
+static uint8_t overlay_dirty = 0;
+static uint8_t knobs = 0;               // latest combination progress
+static uint8_t digits = 0;              // latest PIN digit count
+
+// draws the four PIN positions, "*" for each digit entered and "-" for the rest
+void draw_PIN_digits(uint8_t count)
 {
-    // PD2 as output
-    DDRD |= (1 << SERVO);
+    for (uint8_t i = 0; i < 4; i++)
+        LCD_drawString(20 + 10 * i, 80, (i < count) ? "*" : "-", BLUE, WHITE, 8);
+}
 
-    // Timer 2 setup (0.5 us ticks with /8 prescaler):    
-    TCCR2A = (1 << WGM21);  // CTC mode
-    TCCR2B = (1 << CS21);   // prescaler = 8
-    OCR2A = 19;             // 10 µs interrupt
+// draws how many of the six combination controls are in position
+void draw_combination_progress(uint8_t knobs)
+{
+    char text[] = "Set: 0/6";
+    uint8_t count = 0;
 
-    // Enable timer compare interrupt
-    TIMSK2 = (1 << OCIE2A);
+    for (uint8_t i = 0; i < 6; i++)
+        count += (knobs >> i) & 1;
+    text[5] = '0' + count;
+    LCD_drawString(29, 70, text, BLUE, WHITE, 8);
+}
 
-    sei();
+void render_show(const screen_t *next)
+{
+    screen = next;
+    render_band = 0;
+    render_label = 0;
+    render_char = 0;
+    overlay_dirty = (next->overlay != OVERLAY_NONE);
 }
 
-// // interrupt for finger print (PC2)
-// void pc2_interrupt_init(void) {
-//     PCICR |= (1<<PCIE1);    // Enable Pin Change Interrupt group 1 (PCINT[14:8])
-//     PCMSK1 |= (1<<PCINT10); // Enable interrupt for PC2 (PCINT10)
+void render_set_knobs(uint8_t value)
+{
+    knobs = value;
+    overlay_dirty |= (screen && screen->overlay == OVERLAY_KNOBS);
+}
 
-//     sei();                  // Enable global interrupts
-// }
+void render_set_digits(uint8_t value)
+{
+    digits = value;
+    overlay_dirty |= (screen && screen->overlay == OVERLAY_DIGITS);
+}
 
-// interrupt service routine for timer 2 to generate pulse on PD2:
-ISR(TIMER2_COMPA_vect)
+uint8_t render_busy(void)
 {
-    tick_counter++;
+    return screen && (render_band < RENDER_BANDS || render_label < screen->count || overlay_dirty);
+}
 
-    if (tick_counter <= servo_pulse_ticks)
-        PORTD |= (1 << SERVO);  // output HIGH for the pulse
-    else
-        PORTD &= ~(1 << SERVO); // output LOW for the pulse
+// one piece of the current screen per call
+void render_task(void)
+{
+    if (!screen)
+        return;
 
-    // Restart 20 ms frame after 2000 ticks (10 us each)
-    if (tick_counter >= 2000)
-        tick_counter = 0;
-}
+    if (render_band < RENDER_BANDS) {
+        uint8_t y = render_band++ * RENDER_BAND_ROWS;
+        LCD_drawBlock(0, y, LCD_WIDTH - 1, y + RENDER_BAND_ROWS - 1, screen->bg);
+        return;
+    }
 
-// ISR(PCINT1_vect) {
-//     // Check if PC2 is actually high
-//     if (PINC & (1<<PC2)) {
-//         fingerprint_read = 1;
-//     }
-// }
+    if (render_label < screen->count) {
+        const label_t *label = &screen->labels[render_label];
+        char c = label->text[render_char];
+        if (c) {
+            draw_char(label->x + 6 * render_char, label->y, c, label->fg, screen->bg);
+            render_char++;
+        } else {
+            render_label++;
+            render_char = 0;
+        }
+        return;
+    }
 
-// ------------------------------------ SERVO CONTROLS --------------------------------------
+    if (overlay_dirty) {
+        overlay_dirty = 0;
+        if (screen->overlay == OVERLAY_KNOBS)
+            draw_combination_progress(knobs);
+        else
+            draw_PIN_digits(digits);
+    }
+}
 
-void servo_set_us(uint16_t us)
+// ------------------------------------ SEQUENCES -------------------------------------------------
+/*
+Timed steps (door, latch, reset line, timed screens) run from one-shot timers instead of Delay_ms(). Each step
+runs and then holds for hold_ms before the next, or with STEP_WAIT until the channel's continue function is
+called (the door motor's done callback). Starting a sequence cancels whatever that channel was doing, so a lock
+command takes over the actuators even while the door is still moving.
+*/
+#define STEP_WAIT 0xFFFF
+#define SEQUENCE_WAITING 0xFE   // timer value while a STEP_WAIT step is pending
+
+typedef struct {
+    void (*run)(void);
+    uint16_t hold_ms;
+} step_t;
+
+typedef struct {
+    const step_t *steps;
+    uint8_t count;
+    uint8_t next;
+    uint8_t timer;      // sched id of the pending hold, SEQUENCE_WAITING, or SCHED_NONE when idle
+} sequence_t;
+
+static sequence_t actuators = {0, 0, 0, SCHED_NONE};
+static sequence_t display = {0, 0, 0, SCHED_NONE};
+
+// runs steps until one has to hold
+static void sequence_step(sequence_t *seq, sched_task_t resume)
 {
-    // constrain pulse to 1000?2000 µs (based on servo data sheet)
-    // this gives about 90 deg ROM, I found that using 500 and 2500 instead gives more ROM
-    if (us < 1000) us = 1000;
-    if (us > 2000) us = 2000;
+    seq->timer = SCHED_NONE;
+    while (seq->next < seq->count) {
+        const step_t *step = &seq->steps[seq->next++];
+        step->run();
+        if (step->hold_ms == STEP_WAIT) {
+            seq->timer = SEQUENCE_WAITING;
+            return;
+        }
+        if (step->hold_ms) {
+            seq->timer = sched_after(resume, step->hold_ms);
+            return;
+        }
+    }
+}
+
+static void actuators_resume(void) { sequence_step(&actuators, actuators_resume); }
+static void display_resume(void) { sequence_step(&display, display_resume); }
 
-    // convert microseconds to 10 µs ticks
-    servo_pulse_ticks = us / 10;
+// ends a STEP_WAIT step; ignored if the sequence has been cancelled or restarted since
+static void actuators_continue(void)
+{
+    if (actuators.timer == SEQUENCE_WAITING)
+        actuators_resume();
 }
 
-// function to map angle in degrees to pulse length in us
-void servo_write_deg(uint8_t angle)
+static void sequence_cancel(sequence_t *seq)
 {
-    if (angle > 180) angle = 180;
+    if (seq->timer != SCHED_NONE && seq->timer != SEQUENCE_WAITING)
+        sched_cancel(seq->timer);
+    seq->timer = SCHED_NONE;
+    seq->count = 0;
+}
 
-    uint16_t us = 600 + ((uint32_t)angle * 1800UL) / 180;
-    servo_set_us(us);
+static void sequence_start(sequence_t *seq, const step_t *steps, uint8_t count, sched_task_t resume)
+{
+    sequence_cancel(seq);
+    seq->steps = steps;
+    seq->count = count;
+    seq->next = 0;
+    resume();
 }
 
-// ------------------------------ MOTOR CONTROLS ------------------------------------
+#define ACTUATORS(list) sequence_start(&actuators, list, sizeof(list) / sizeof(list[0]), actuators_resume)
+#define DISPLAY(list) sequence_start(&display, list, sizeof(list) / sizeof(list[0]), display_resume)
+
+// ------------------------------------ POWER -------------------------------------------------
+/*
+The panel keeps its RAM and takes SPI writes while asleep, so screens are painted whatever the level and show as
+soon as it wakes (SLPOUT, 5 ms). This MCU only ever idles between passes: its USART is off in power-down, and the
+first bytes of an identity frame from the ESP32 would be lost while the crystal starts up.
+
+SLPOUT must not follow SLPIN within LCD_SLEEP_MS. Rather than wait that out inside the pass, a one-shot marks the
+end of it; a level change that comes sooner is held until then. No free slot for the one-shot means no SLPIN:
+the backlight still goes off.
+*/
+static uint8_t panel_asleep = 0;
+static uint8_t panel_level = POWER_ACTIVE;      // latest level from the power manager
+static uint8_t panel_settle = SCHED_NONE;       // one-shot until SLPOUT is allowed again
 
-// function that reads ADC in the given channel
-// uint16_t adc_read(uint8_t ch) {
-//     ADMUX = (ADMUX & 0xF0) | (ch & 0x0F);   // select channel to measure (only change bottom 4 bits - MUX3, MUX2, MUX1, MUX 0)
-//     ADCSRA |= (1<<ADSC);                    // start ADC conversion
-//     while (ADCSRA & (1<<ADSC));             // while loop that wait for conversion to finish (ADSC --> 0)
-//     return ADC;                             // return measured ADC
-// }
+static void panel_apply(void);
 
-// function to stop motor:
-void motor_stop() {
-    // OCR0B = 0;              // set speed to 0
-    PORTD &= ~(1<<IN1);     // set IN1 to 0
-    PORTD &= ~(1<<IN2);     // set IN2 to 0
+static void panel_settled(void)
+{
+    panel_settle = SCHED_NONE;
+    panel_apply();
 }
 
-// function to move motor up at a given speed:
-void motor_up(uint8_t speed) {
-    PORTD |=  (1<<IN1);     // set IN1 HIGH
-    PORTD &= ~(1<<IN2);     // set IN2 LOW
-    // OCR0B = speed;          // set timer output compare to speed (0-255)
+static void panel_apply(void)
+{
+    if (panel_level == POWER_OFF) {
+        LCD_backlight(0);
+        if (!panel_asleep && (panel_settle = sched_after(panel_settled, LCD_SLEEP_MS)) != SCHED_NONE) {
+            LCD_sleep();
+            panel_asleep = 1;
+        }
+        return;
+    }
+    if (panel_asleep) {
+        LCD_wake();
+        panel_asleep = 0;
+    }
+    LCD_idle_mode(panel_level == POWER_DIM);
+    LCD_backlight(panel_level == POWER_DIM ? BACKLIGHT_DIM : LCD_BACKLIGHT);
 }
 
-// function to move motor down at a given speed:
-void motor_down(uint8_t speed) {
-    PORTD &= ~(1<<IN1);     // set IN1 LOW
-    PORTD |=  (1<<IN2);     // set IN2 HIGH
-    // OCR0B = speed;          // set timer output compare for speed
+static void lcd_power(uint8_t level)
+{
+    panel_level = level;
+    if (panel_settle == SCHED_NONE)
+        panel_apply();      // otherwise panel_settled() applies it
 }
 
-// ------------------------------------ MCU COMMUNICATION -------------------------------------------------
+// ------------------------------------ VAULT STATE MACHINE ACTIONS (see vault_fsm.h) ------------------------------
+
+vault_fsm_t vault;
+uint8_t await_finger = 0;   // fingerprint screen up and no identity passed on yet
+mcu_msg_t stage_msg;        // last STAGE message, acknowledged once its sequences and screen are done
+uint8_t stage_pending = 0;
+
+static void show_locked(void) { render_show(&screen_locked); }
+static void show_combination(void) { render_set_knobs(0); render_show(&screen_combination); }
+static void show_accepted(void) { render_show(&screen_accepted); }
+static void show_pin(void) { render_set_digits(0); render_show(&screen_pin); }
+static void latch_open(void) { render_show(&screen_pin_ok); servo_move_deg(open, LATCH_RAMP_MS); }
+static void latch_close(void) { servo_move_deg(closed, LATCH_RAMP_MS); }
+static void door_done(uint8_t reason) { actuators_continue(); }
+static void door_open(void) { motor_move(MOTOR_DOWN, &door_profile, door_done); }
+static void door_close(void) { motor_move(MOTOR_UP, &door_profile, door_done); }
+static void door_opened(void) { trace_mark(TRACE_LCD_DOOR_OPEN, 0); }
+
+static void unlocked(void)
+{
+    trace_mark(TRACE_LCD_LATCH_OPEN, 0);
+    render_show(&screen_unlocked);
+}
 
-void talk_to_MCU(uint8_t state){ // PC3 = bit0, PC4 = bit1, PC5 = bit2. Parallel 3 bit comms. SENDING TO LCD
-    // Clear PC3, PC4, PC5
-    PORTC &= ~((1 << BIT0) | (1 << BIT1) | (1 << BIT2));
+// the finger has to be presented while the fingerprint screen is up, drop anything queued during lockdown
+static void locked(void)
+{
+    trace_mark(TRACE_LCD_LOCKED, 0);
+    render_show(&screen_fingerprint);
+    vault_link_flush();
+    await_finger = 1;
+}
 
-    // Mask state to 3 bits (0?7) and shift into PC3?PC5
-    PORTC |= (state & 0x07) << BIT0;
-    //printf("State:%u \r\n",state);
+// lock command: stop the door, reset the fingerprint side, then close the latch and the door
+static void lock_start(void)
+{
+    motor_stop();
+    render_show(&screen_locking);
+    reset_line_raise(); // tell the fingerprint side to reset
 }
 
-// function that checks state of progress from other MCU
-uint8_t read_inputs(void)
+static void lock_latch(void)
 {
-    uint8_t pin_state = PINC;  // Read entire port once (best practice)
+    reset_line_release();
+    show_locked();
+    latch_close();
+}
 
-    uint8_t BIT0_high     = (pin_state & (1 << BIT0))     != 0;
-    uint8_t BIT1_check_high = (pin_state & (1 << BIT1)) != 0;
-    uint8_t BIT2_check_high = (pin_state & (1 << BIT2)) != 0;
+static const step_t open_door_steps[] = {{door_open, STEP_WAIT}, {door_opened, 0}};
+static const step_t accepted_steps[] = {{show_accepted, ACCEPTED_MS}, {show_pin, 0}};
+static const step_t unlock_steps[] = {{latch_open, LATCH_MS}, {unlocked, 0}};
+static const step_t lock_steps[] = {{lock_start, RESET_PULSE_MS}, {lock_latch, LATCH_MS}, {door_close, STEP_WAIT},
+                                    {locked, 0}};
+// power-up: make sure box and sliding door are closed
+static const step_t lockdown_steps[] = {{show_locked, 0}, {latch_close, LATCH_MS}, {door_close, STEP_WAIT},
+                                        {locked, 0}};
+
+// identity accepted by the keypad MCU: open the sliding door and ask for the combination
+void action_start(uint8_t arg){
+    ACTUATORS(open_door_steps);
+    show_combination();
+}
 
-    // return a bitmask:
-    return (BIT2_check_high << 2) | (BIT1_check_high << 1) | (BIT0_high);
+// combination lost while entering the PIN
+void action_combination(uint8_t arg){
+    sequence_cancel(&display);
+    show_combination();
 }
 
-/*
-Possible states for transmitter:
-0 - wait
-1 - switch
-*/
+// combination accepted: show it for a second, then ask for the PIN
+void action_pin(uint8_t arg){
+    DISPLAY(accepted_steps);
+}
+
+void action_wrong_pin(uint8_t arg){
+    sequence_cancel(&display);
+    render_show(&screen_wrong_pin);
+}
 
+// wrong PIN shown for its timeout: ask again
+void action_retry(uint8_t arg){
+    sequence_cancel(&display);
+    show_pin();
+}
+
+// correct PIN: open the latch
+void action_unlock(uint8_t arg){
+    sequence_cancel(&display);
+    ACTUATORS(unlock_steps);
+}
+
+// lock command: reset the fingerprint side, close everything and wait for the next finger
+void action_lock(uint8_t arg){
+    trace_mark(TRACE_LCD_LOCK, 0);
+    sequence_cancel(&display);
+    ACTUATORS(lock_steps);
+}
+
+const vault_action_t lcd_actions[VAULT_ACTION_COUNT] = {
+    [VAULT_ACT_START] = action_start,
+    [VAULT_ACT_COMBINATION] = action_combination,
+    [VAULT_ACT_PIN] = action_pin,
+    [VAULT_ACT_WRONG_PIN] = action_wrong_pin,
+    [VAULT_ACT_RETRY] = action_retry,
+    [VAULT_ACT_UNLOCK] = action_unlock,
+    [VAULT_ACT_LOCK] = action_lock,
+};
+
+// ------------------------------------ BUS HANDLING -------------------------------------------------
+
+// returns the identity code once a frame with a known template ID has arrived, 0 until then (rejects keep us waiting)
 uint8_t read_fingerprint_holder(void)
 {
-    // placeholder screen:
-    LCD_setScreen(WHITE);
-    LCD_drawString(15, 50, "Waiting for Fingerprint", BLUE, WHITE, 8);
-    Delay_ms(50);
-
-    // Wait loop: Wait until EITHER FINGER0 or FINGER1 goes high
-    // This assumes that "00" is the "no signal" state.
-    while( !((PINC & (1<<FINGER0)) || (PINC & (1<<FINGER1))) ){
-        Delay_ms(2);
-    }
+    vault_link_frame_t frame;
 
-    Delay_ms(50); // Allow signals to settle
+    if (!vault_link_poll(&frame))
+        return 0;
+    power_activity();   // someone is at the sensor, known finger or not
+    if (frame.type != VAULT_LINK_IDENTITY || frame.id >= sizeof(identity_codes))
+        return 0;
 
-    // Construct the 2-bit value using bit manipulation
-    uint8_t fp_value = ((PINC >> FINGER0) & 0x01) | (((PINC >> FINGER1) & 0x01) << 1);
+    trace_mark(TRACE_LCD_IDENTITY, identity_codes[frame.id]);
+    render_show(&identity_greetings[frame.id]);
 
-    Delay_ms(50);
-    
-    LCD_setScreen(WHITE);
-    if (fp_value == 1){
-      LCD_drawString(20, 50, "Welcome, Jeevan", BLUE, WHITE, 8);  
-    }
-    if (fp_value == 2){
-      LCD_drawString(20, 50, "Welcome, Yongwoo", BLUE, WHITE, 8);  
-    }
-    if (fp_value == 3){
-      LCD_drawString(20, 50, "Welcome, Tomas", BLUE, WHITE, 8);  
-    }
-    
-    Delay_ms(100);
-
-    return fp_value; // Return the identity value
+    return identity_codes[frame.id]; // Return the identity value
 }
 
 /*
-Possible states (for receiver):
-0 - ADC wrong
-1 - ADC correct
-2 - Wait
-3 - Pin value entered
-4 - Clear
-5 - Correct PIN
-6 - Wrong PIN
-7 - 
+Messages from the keypad MCU (see mcu_link.h):
+STAGE  - new vault state, the transition's action runs through the shared table
+KNOBS  - combination progress
+DIGITS - number of PIN digits entered (0 = cleared)
+Stage changes are acknowledged once their sequences have finished and the screen is painted (box closed for a
+lock) so the keypad MCU can trace them. A newer stage acknowledges the one it replaced straight away.
 */
+void LCD_receiveControls(const mcu_msg_t *msg){
+    trace_mark(TRACE_LCD_MSG, msg->type);
+    power_activity();
+    //printf("MSG: %u %u \r\n", msg->type, msg->arg);    // print message (for debugging)
+
+    if (msg->type == MCU_MSG_STAGE){
+        if (stage_pending)
+            mcu_link_ack(&stage_msg);
+        // a stage with no transition from ours is out of step, leave the screen alone
+        vault_fsm_follow(&vault, msg->arg, 0, timebase_ms());
+        stage_msg = *msg;
+        stage_pending = 1;
+    }
 
-uint8_t LCD_receiveControls(void){
-    uint8_t state = read_inputs();      // check state
-    //printf("STATE: %u \r\n", state);    // print state (for debugging)
-    uint8_t prev_state = 10;            // initialize previous state as 10 so it doesn't mess with the logic (will be overwritten shortly)
-    uint8_t PIN_count = 0;              // set pin count to 0
-    uint8_t not_done = 1;               // keep track of whether the right combination and pin have been received
-
-    // loop that runs as long as the right combination and pin haven't been received:
-    while(not_done){
-        state = read_inputs();              // check state
-        //printf("STATE: %u \r\n", state);    // print state
-
-        // if the correct combination hasn't been received:
-        if ((state == 0)&(prev_state!=0)){
-            prev_state = 0;                 // set previous state to 0
-            // display correspnding screen on LCD:
-            LCD_setScreen(WHITE);
-            LCD_drawString(29, 50, "Enter Combination", BLUE, WHITE, 8);
-            // wait for the state to change:
-            while(state == 0){
-                state = read_inputs();
-                Delay_ms(5);
-            }
-        }
-
-        // if the correct combination was received:
-        if ((state == 1))
-        {
-            prev_state = 1;         // set previous state to 1
-            // display combination accepted screen for 1 second:
-            LCD_setScreen(WHITE);
-            LCD_drawString(20, 50, "Combination Accepted", BLUE, WHITE, 8);
-            Delay_ms(1000);
-            // display "Enter PIN" screen:
-            LCD_setScreen(WHITE);
-            LCD_drawString(20, 45, "Enter PIN:", BLUE, WHITE, 8);
-            LCD_drawString(20, 55, "# to finish", BLUE, WHITE, 8);
-            LCD_drawString(20, 80, "-", BLUE, WHITE, 8);
-            LCD_drawString(30, 80, "-", BLUE, WHITE, 8);
-            LCD_drawString(40, 80, "-", BLUE, WHITE, 8);
-            LCD_drawString(50, 80, "-", BLUE, WHITE, 8);
-            PIN_count = 0;  // set PIN count to 0
-            // wait for state to change
-            while(state == 1){
-                state = read_inputs();
-                Delay_ms(5);
-            }
-        }
+    // combination progress and PIN digits, drawn if their screen is up
+    else if (msg->type == MCU_MSG_KNOBS){
+        render_set_knobs(msg->arg);
+    }
+    else if (msg->type == MCU_MSG_DIGITS){
+        render_set_digits(msg->arg);
+    }
+}
 
-        // if in state 2 - just waiting for comunication
-        if (state == 2)
-        {
-            Delay_ms(5);
-            state = read_inputs();  // check state
-        }
+// fingerprint link and keypad MCU messages, on every pass
+void bus_task(void){
+    mcu_msg_t msg;
 
-        // if PIN value was entered:
-        if (state == 3)
-        {
-            prev_state = 3; // set previous state to 3
-            // first PIN value entered:
-            if (PIN_count == 0){
-                // replace "-" with "*" on LCD screen
-                LCD_drawString(20, 80, "*", BLUE, WHITE, 8);
-                PIN_count += 1;
-            }
-            // second PIN value entered:
-            else if (PIN_count == 1)
-            {
-                // replace "-" with "*" on LCD screen
-                LCD_drawString(30, 80, "*", BLUE, WHITE, 8);
-                PIN_count += 1;
-            }
-            // third PIN value entered:
-            else if (PIN_count == 2)
-            {
-                // replace "-" with "*" on LCD screen
-                LCD_drawString(40, 80, "*", BLUE, WHITE, 8);
-                PIN_count += 1;
-            }
-            // fourth PIN value entered:
-            else if (PIN_count == 3)
-            {
-                // replace "-" with "*" on LCD screen
-                LCD_drawString(50, 80, "*", BLUE, WHITE, 8);
-                PIN_count += 1;
-            }
-            // reset PIN count if else:
-            else {
-                PIN_count = 0;
-                Delay_ms(5);
-            }
-            // wait for state to change:
-            while(state == 3){
-                state = read_inputs();
-                Delay_ms(5);
-            }
+    // --- AUTHENTICATION ---
+    if (await_finger){
+        uint8_t finger_identity = read_fingerprint_holder();
+        if (finger_identity){
+            mcu_link_flush();   // nothing from the last session is still relevant
+            talk_to_MCU(MCU_MSG_IDENTITY, finger_identity);
+            await_finger = 0;
         }
+    }
 
-        // if the user clears the PIN values entered:
-        if (state == 4)
-        {
-            PIN_count = 0;  // reset PIN count
-            // check if the PIN was entered incorrectly
-            if (prev_state == 5){
-                // reset entire screen display
-                LCD_setScreen(WHITE);
-                LCD_drawString(20, 50, "Enter PIN:", BLUE, WHITE, 8);
-            }
-            // reset PIN "- - - -"
-            LCD_drawString(20, 80, "-", BLUE, WHITE, 8);
-            LCD_drawString(30, 80, "-", BLUE, WHITE, 8);
-            LCD_drawString(40, 80, "-", BLUE, WHITE, 8);
-            LCD_drawString(50, 80, "-", BLUE, WHITE, 8);
-            prev_state = 4; // set previous state
-            
-            // wait for state to change:
-            while(state == 4){
-                state = read_inputs();
-                Delay_ms(5);
-            }
-        }
+    // --- COMBINATION, PIN, UNLOCKED, LOCK ---
+    if (mcu_link_poll(&msg))
+        LCD_receiveControls(&msg);
 
-        // if the user inputs the incorrect pin:
-        if (state == 5)
-        {
-            // set corresponding screen display:
-            LCD_setScreen(RED);
-            LCD_drawString(41, 60, "Incorrect PIN", WHITE, RED, 8);
-            LCD_drawString(41, 80, "Press * to retry", WHITE, RED, 8);
-            // wait for state to change:
-            prev_state = state; // save previous state
-            // wait for state to change:
-            while(state == 5){
-                state = read_inputs();
-                Delay_ms(5);
-            }
-        }
+    // nothing dims while the box is moving or a screen is going up
+    if (actuators.timer != SCHED_NONE || display.timer != SCHED_NONE || render_busy())
+        power_activity();
 
-        // if the user inputs the correct pin
-        if (state == 6)
-        {
-            // set corresponding screen display:
-            LCD_setScreen(GREEN);
-            LCD_drawString(44, 60, "PIN accepted", WHITE, GREEN, 8);
-            not_done = 0;           // signal that the function is done
-            prev_state = state;     // save previous state
-            // wait for state to change:
-            while(state == 0){
-                state = read_inputs();
-                Delay_ms(5);
-            }
-        }
+    if (stage_pending && actuators.timer == SCHED_NONE && display.timer == SCHED_NONE && !render_busy()){
+        mcu_link_ack(&stage_msg);
+        stage_pending = 0;
+        trace_mark(TRACE_LCD_SCREEN, vault.state);
+        if (vault.state == VAULT_LOCKED)
+            trace_dump();
     }
-    return not_done;   
-}
-
-// subroutine to open latch with servo
-void openBox(void){
-    servo_write_deg(open);
-    Delay_ms(1000);
-}
-
-// subroutine to close latch with servo
-void closeBox(void){
-    servo_write_deg(closed);
-    Delay_ms(1000);
 }
 
 int main(void){
     // initialize pins:
-    setup_outputs(); // Initialize as output first for safety, loop handles switching
+    setup_outputs(); // Initialize as output first for safety
+    timebase_init();
+    vault_link_init();
+    trace_init("lcd", 0);
+    mcu_link_init(MCU_LINK_ADDR_LCD, MCU_LINK_ADDR_KEYPAD);
     servo_init();
     LCD_init();
     motor_init();
+    vault_fsm_init(&vault, lcd_actions, timebase_ms());
     
-    // START INFINITE LOOP (Security System Loop)
-    while(1) {
-        
-        // --- 1. LOCKDOWN & RESET STATE ---
-        // Ensure inputs/outputs are correct for Fingerprint phase (this MCU talks TO other)
-        setup_outputs(); 
-
-        // make sure box is closed:
-        LCD_setScreen(WHITE);
-        LCD_drawString(20, 50, "System Locked", RED, WHITE, 8);
-        Delay_ms(50);
-        closeBox();
-        
-        // make sure sliding door is closed:
-        motor_up(200);
-        Delay_ms(500); // Give motor time to close door
-        motor_stop();
-        
-        // --- 2. AUTHENTICATION ---
-        // wait for fingerprint to be accepted:
-        uint8_t finger_identity = read_fingerprint_holder();
-        talk_to_MCU(finger_identity);
-        Delay_ms(50);
-        
-        // --- 3. PIN ENTRY PHASE ---
-        // Switch communication direction: We now listen to the other MCU
-        setup_inputs();
-        
-        // open sliding door:
-        motor_down(200);
-        Delay_ms(500);
-        motor_stop();
-        
-        // wait for correct combination + PIN:
-        uint8_t fook = 0;
-        LCD_setScreen(WHITE);
-        fook = LCD_receiveControls();
-        
-        // --- 4. UNLOCKED STATE ---
-        // open latch
-        openBox();
-        
-        LCD_setScreen(GREEN);
-        LCD_drawString(20, 50, "UNLOCKED", WHITE, GREEN, 8);
-        LCD_drawString(20, 70, "Press * to Lock", WHITE, GREEN, 8);
-        
-        // --- 5. WAIT FOR LOCK SIGNAL (State 7) ---
-        uint8_t current_state = 0;
-        
-        // Stay in this loop while the state IS NOT 7
-        while (current_state != 7) {
-            current_state = read_inputs();
-            Delay_ms(5); // check every 5ms
-        }
-        
-        // If we break the loop, state 7 was received
-        LCD_setScreen(RED);
-        LCD_drawString(20, 50, "LOCKING SYSTEM...", WHITE, RED, 8);
-        PORTC |=  (1 << FINGER_OUT); // finger out high, tell it to reset
-        Delay_ms(500);
-        PORTC &=  ~(1 << FINGER_OUT); // set it back low
-    }
+    // START EVENT LOOP (Security System Loop), the keypad MCU drives the states
+    sched_init();
+    sched_every(bus_task, 0);
+    sched_every(render_task, 0);
+    power_init(DIM_MS, OFF_MS, lcd_power, 0);
+    ACTUATORS(lockdown_steps);
+    
+    while(1)
+        sched_run();
 }
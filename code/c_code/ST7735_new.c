@@ -6,9 +6,7 @@ LCD driver
 #define F_CPU 16000000UL   // set to MCU clock — change if different
 #endif
 
-#include <avr/io.h>
-#include <util/delay.h>
-#include <avr/pgmspace.h>
+#include "hal.h"
 #include "ST7735_new.h"
 
 // Just using _delay_ms() was giving me issues because it expected a "time integer constant", so this function
@@ -16,54 +14,45 @@ LCD driver
 
 void Delay_ms(unsigned int n)
 {
-    while (n--) {
-        _delay_ms(1);    // _delay_ms accepts a compile-time constant here, 1 is fine
-    }
+    hal_delay_ms(n);    // loops _delay_ms(1) on the AVR
 }
 
 
 // pin initialization
 static void LCD_pin_init(void){
     // digital pin setup (all output pins):
-    LCD_DDR |= (1<<LCD_DC);       // data/command (output)
-    LCD_DDR |= (1<<LCD_RST);      // reset (output)
-    LCD_DDR |= (1<<LCD_TFT_CS);   // chip select (output)
-    LCD_DDR |= (1<<LCD_MOSI);     // Master Out Slave In (output)
-    LCD_DDR |= (1<<LCD_SCK);      // clock (output)
-    LCD_LITE_DDR |= (1<<LCD_LITE);
+    hal_gpio_output(LCD_PORT, (1<<LCD_DC));       // data/command (output)
+    hal_gpio_output(LCD_PORT, (1<<LCD_RST));      // reset (output)
+    hal_gpio_output(LCD_PORT, (1<<LCD_TFT_CS));   // chip select (output)
+    hal_gpio_output(LCD_PORT, (1<<LCD_MOSI));     // Master Out Slave In (output)
+    hal_gpio_output(LCD_PORT, (1<<LCD_SCK));      // clock (output)
+    hal_gpio_output(LCD_LITE_PORT, (1<<LCD_LITE));
 
     // Brightness control using PWM:
-    // PWM setup:
-    TCCR0A |= (1<<COM0A1);    // non-inverting PWM mode
-    TCCR0A |= (1<<WGM01);     // Fast PWM, TOP=0xFF
-    TCCR0A |= (1<<WGM00);     // Fast PWM, TOP=0xFF
-    TCCR0B |= (1<<CS02);      // /256 prescaler (62,500 Hz/256 = 244 Hz - fast PWM freq is 62,500 Hz)
-    OCR0A = 100;            // 39% duty cycle for low-ish brightness
+    // fast PWM on OC0A, /256 prescaler (62,500 Hz/256 = 244 Hz)
+    hal_pwm0a_init(LCD_BACKLIGHT);
 
     // Default pin states BEFORE reset:
-    LCD_PORT |= (1<<LCD_TFT_CS);  // CS high = inactive
-    LCD_PORT &= ~(1<<LCD_DC);     // DC low = command by default
-    LCD_PORT |= (1<<LCD_RST);     // make sure RESET starts HIGH
+    hal_gpio_high(LCD_PORT, (1<<LCD_TFT_CS));  // CS high = inactive
+    hal_gpio_low(LCD_PORT, (1<<LCD_DC));       // DC low = command by default
+    hal_gpio_high(LCD_PORT, (1<<LCD_RST));     // make sure RESET starts HIGH
 
     // Hardware reset pulse (active low)
-    LCD_PORT &= ~(1<<LCD_RST);    // RST = low
+    hal_gpio_low(LCD_PORT, (1<<LCD_RST));      // RST = low
     Delay_ms(20);                 // hold reset low (>=10ms recommended)
-    LCD_PORT |= (1<<LCD_RST);     // RST = high
+    hal_gpio_high(LCD_PORT, (1<<LCD_RST));     // RST = high
     Delay_ms(150);                // wait for internal startup
 }
 
 // SPI controller initialization in master mode
 static void SPI_controller_init(void){
-    SPCR0 |= (1<<SPE);        // enable SPI module
-    SPCR0 |= (1<<MSTR);       // set MCU as SPI master
-    // clock rate is set to default (SPR01 = 0, SPR00 = 0), which is fck/4
-    SPSR0 |= (1<<SPI2X);      // double the SPI speed (so fck/2 = 8 MHz)
+    // enable SPI module as master, default fck/4 clock doubled with SPI2X (so fck/2 = 8 MHz)
+    hal_spi_init();
 }
 
 // SPI helper function to send 1 byte of data (8 bits) by loading it into data register and waiting for the SPI to transmit it
 void SPI_controllerTx_byte(uint8_t data){
-    SPDR0 = data;       // write byte on SPI data register
-    while(!(SPSR0 & (1<<SPIF)));    // do nothing while waiting for SPIF flag to become 1 (means transmission is complete)
+    hal_spi_write(data);    // write byte on SPI data register and wait for SPIF (means transmission is complete)
 }
 
 // helper function that splits a 16-bit value into 2 bytes to send over SPI, also controlling chip select to select
@@ -72,11 +61,11 @@ void SPI_controllerTx(uint16_t data){
     uint8_t low = data & 0xFF;   // extract lower 8 bits
     uint8_t high = (data >> 8);  // extract upper 8 bits
 
-    LCD_PORT &= ~(1<<LCD_TFT_CS);       // pull chip select low to tell LCD data transfer is starting
+    hal_gpio_low(LCD_PORT, (1<<LCD_TFT_CS));    // pull chip select low to tell LCD data transfer is starting
     SPI_controllerTx_byte(high);        // send upper 8 bits using helper function
     SPI_controllerTx_byte(low);         // send lower 8 bits using helper function
 
-    LCD_PORT |= (1<<LCD_TFT_CS);          // pull chip select high to tell LCD data transfer is done
+    hal_gpio_high(LCD_PORT, (1<<LCD_TFT_CS));   // pull chip select high to tell LCD data transfer is done
 }
 
 // // command structure for initialization:
@@ -203,15 +192,15 @@ void LCD_init(void){
 // of entries in that array. Should work for any list of commands
 void sendCommands(const lcd_cmd_t *cmdList, uint8_t count)
 {
-    LCD_PORT &= ~(1<<LCD_TFT_CS);   // CS low - begin communication for init sequence
+    hal_gpio_low(LCD_PORT, (1<<LCD_TFT_CS));    // CS low - begin communication for init sequence
 
     for (uint8_t i = 0; i < count; i++) {   // loop over each command entry - note that max count = 255
 
-        LCD_PORT &= ~(1<<LCD_DC);   // command mode
+        hal_gpio_low(LCD_PORT, (1<<LCD_DC));    // command mode
         SPI_controllerTx_byte(cmdList[i].cmd);  // sends the cmd byte using helper function
 
         if (cmdList[i].numArgs > 0) {   // check for data bytes
-            LCD_PORT |= (1<<LCD_DC);    // switch to data mode
+            hal_gpio_high(LCD_PORT, (1<<LCD_DC));   // switch to data mode
             for (uint8_t j = 0; j < cmdList[i].numArgs; j++) {  // loop over bytes stored in cmdList
                 SPI_controllerTx_byte(cmdList[i].args[j]);  // send byte using helper functino
             }
@@ -221,7 +210,7 @@ void sendCommands(const lcd_cmd_t *cmdList, uint8_t count)
             Delay_ms(cmdList[i].delayMs);  // delay 
     }
 
-    LCD_PORT |= (1<<LCD_TFT_CS);    // CS high - end communication
+    hal_gpio_high(LCD_PORT, (1<<LCD_TFT_CS));   // CS high - end communication
 }
 
 // function that sets the memory address of the pixel we want to write to
@@ -233,8 +222,40 @@ void LCD_setAddress(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1)
     lcd_cmd_t cmds[] = {
         {CASET, 4, c_args, 0},     // set column range
         {RASET, 4, r_args, 0},     // set row range
-        {RAMWR, 0, NULL, 10}       // begin writing to RAM
+        {RAMWR, 0, NULL, 0}        // begin writing to RAM, no wait needed before the pixel data
     };
 
     sendCommands(cmds, 3);     // send commands
 }
+
+// ---------------------------------- POWER -------------------------------------------
+
+// backlight duty cycle on PD6, 0 turns it fully off
+void LCD_backlight(uint8_t duty)
+{
+    hal_pwm0a_set(duty);
+}
+
+// idle mode: 8 colours (the top bit of each of R, G and B) for less panel current; RAM keeps every colour
+void LCD_idle_mode(uint8_t on)
+{
+    lcd_cmd_t cmd = {on ? IDMON : IDMOFF, 0, NULL, 0};
+    sendCommands(&cmd, 1);
+}
+
+// sleep in: booster and panel scanning off, RAM and the SPI interface keep working so screens can still be
+// drawn. SLPOUT is not allowed for LCD_SLEEP_MS after SLPIN (pg. 94); that is left to the caller, so it can wait
+// without blocking (LCD_comms.c holds LCD_wake() back with a sched one-shot)
+void LCD_sleep(void)
+{
+    lcd_cmd_t cmd = {SLPIN, 0, NULL, 0};
+    sendCommands(&cmd, 1);
+}
+
+// sleep out: the supplies need 5 ms before the next command. SLPIN is not allowed for 120 ms after this either,
+// which the power manager's timeouts are far longer than
+void LCD_wake(void)
+{
+    lcd_cmd_t cmd = {SLPOUT, 0, NULL, 5};
+    sendCommands(&cmd, 1);
+}
@@ -4,7 +4,7 @@ Author: Tomas
 Note: someone should definitely double check this because I have no clue if it is going to work
 */
 
-#include <avr/io.h>
+#include "hal.h"
 #include <stdlib.h>
 #include <stddef.h>   // for NULL
 
@@ -12,18 +12,17 @@ Note: someone should definitely double check this because I have no clue if it i
 #define ST7735_new_H_
 
 // LCD pin connections based on Lab 4:
-#define LCD_PORT		PORTB
-#define LCD_DDR			DDRB
-#define LCD_DC			PORTB0
-#define LCD_RST			PORTB1
-#define LCD_TFT_CS		PORTB2
-#define LCD_MOSI		PORTB3
-#define LCD_SCK			PORTB5
+#define LCD_PORT		HAL_PORTB
+#define LCD_DC			PB0
+#define LCD_RST			PB1
+#define LCD_TFT_CS		PB2
+#define LCD_MOSI		PB3
+#define LCD_SCK			PB5
 
 //PWM on pin 6 for brightness control/connect to 5V for full brightness
-#define LCD_LITE_PORT	PORTD
-#define LCD_LITE_DDR	DDRD
-#define LCD_LITE		PORTD6
+#define LCD_LITE_PORT	HAL_PORTD
+#define LCD_LITE		PD6
+#define LCD_BACKLIGHT	100     // 39% duty cycle for low-ish brightness, 0 = off
 
 // LCD height, width, and size in pixels (from data sheet):
 #define LCD_WIDTH 160
@@ -94,6 +93,8 @@ Note: someone should definitely double check this because I have no clue if it i
 #define MADCTL_RGB 0x00 // RGB pixel format
 #define MADCTL_MH 0x04  // control direction of LCD refresh: left to right or right to left
 
+#define LCD_SLEEP_MS 120   // SLPIN to the earliest SLPOUT
+
 typedef struct {
     uint8_t cmd;           // command code
     uint8_t numArgs;       // number of argument bytes
@@ -107,5 +108,9 @@ void LCD_setAddress(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1);
 void SPI_controllerTx_byte(uint8_t stream);
 void SPI_controllerTx(uint16_t data);
 void Delay_ms(unsigned int n);
+void LCD_backlight(uint8_t duty);
+void LCD_idle_mode(uint8_t on);
+void LCD_sleep(void);
+void LCD_wake(void);
 
 #endif /* ST7735_NEW_H_ */
\ No newline at end of file
@@ -0,0 +1,102 @@
+/*
+Interrupt-driven, oversampling ADC sampler
+*/
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "adc.h"
+
+#if ADC_OVERSAMPLE_LOG2 > 6
+#error "ADC_OVERSAMPLE_LOG2 above 6 overflows the 16-bit sum"
+#endif
+#if ADC_EXTRA_BITS > ADC_OVERSAMPLE_LOG2 / 2
+#error "ADC_EXTRA_BITS needs 4 conversions per extra bit"
+#endif
+
+#define ADC_SHIFT (ADC_OVERSAMPLE_LOG2 - ADC_EXTRA_BITS)
+#define ADC_ROUNDING (ADC_SHIFT ? (1 << ADC_SHIFT) >> 1 : 0)
+
+static volatile uint16_t buffer[2][ADC_CHANNELS];
+static volatile uint8_t front = 0;      // half adc_latest() copies, the ISR fills the other one
+static volatile uint8_t rounds = 0;     // completed rounds, bumped with every swap
+static volatile uint8_t busy = 0;
+static volatile uint8_t ready = 0;      // a round has completed since adc_init()
+
+// ISR state for the round in progress
+static uint8_t channel;
+static uint8_t count;                   // conversions on this channel, including the discarded one
+static uint16_t sum;
+
+void adc_init(void)
+{
+    // Set PC0, PC1, PC2 as inputs with their digital input buffers off
+    DDRC &= ~((1 << PC0) | (1 << PC1) | (1 << PC2));
+    DIDR0 = (1 << ADC0D) | (1 << ADC1D) | (1 << ADC2D);
+
+    ADMUX = (1 << REFS0);                                                 // AVCC reference
+    ADCSRA = (1 << ADIE) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);    // /128 = 125 kHz, off until a round
+    sei();
+}
+
+// starts a round unless one is still running
+void adc_start(void)
+{
+    if (busy)
+        return;
+    busy = 1;
+    channel = 0;
+    count = 0;
+    sum = 0;
+    ADMUX = (1 << REFS0);
+    ADCSRA |= (1 << ADEN) | (1 << ADSC);    // first conversion after enabling takes 25 ADC clocks, and is discarded
+}
+
+ISR(ADC_vect)
+{
+    uint16_t sample = ADC;
+
+    if (count++)        // the first conversion after switching the multiplexer is thrown away
+        sum += sample;
+
+    if (count <= ADC_OVERSAMPLE) {
+        ADCSRA |= (1 << ADSC);
+        return;
+    }
+
+    buffer[front ^ 1][channel] = (sum + ADC_ROUNDING) >> ADC_SHIFT;
+    sum = 0;
+    count = 0;
+
+    if (++channel < ADC_CHANNELS) {
+        ADMUX = (1 << REFS0) | channel;
+        ADCSRA |= (1 << ADSC);
+        return;
+    }
+
+    ADCSRA &= ~(1 << ADEN);     // the ADC draws current in every sleep mode while enabled
+    front ^= 1;
+    rounds++;
+    ready = 1;
+    busy = 0;
+}
+
+// a round is still converting
+uint8_t adc_busy(void)
+{
+    return busy;
+}
+
+// copies the last complete round into values, returns 0 before the first round is done
+uint8_t adc_latest(uint16_t values[ADC_CHANNELS])
+{
+    uint8_t round;
+
+    // a swap in the middle of the copy shows up as a new round count, copy again
+    do {
+        round = rounds;
+        const volatile uint16_t *latest = buffer[front];
+        for (uint8_t i = 0; i < ADC_CHANNELS; i++)
+            values[i] = latest[i];
+    } while (round != rounds);
+
+    return ready;
+}
@@ -0,0 +1,30 @@
+/*
+Header file for the interrupt-driven ADC sampler on the keypad MCU
+
+adc_start() begins a round in the background: the ADC-complete interrupt converts ADC0..ADC_CHANNELS-1
+(PC0-PC2, the knobs) in turn, ADC_OVERSAMPLE conversions each after one discarded conversion while the
+multiplexer settles, and stores their average in the back half of a double buffer. The halves swap when the
+round is done, so adc_latest() always copies one complete round without turning interrupts off.
+
+At the /128 prescaler a conversion takes 104 us, so a round of 3 channels x (16 + 1) takes about 5.3 ms: start
+one every sample period of 10 ms or more and the previous round is always finished. The ADC is switched off
+between rounds, since it draws current in every sleep mode while enabled.
+*/
+
+#ifndef ADC_H_
+#define ADC_H_
+
+#include <stdint.h>
+
+#define ADC_CHANNELS 3              // ADC0-ADC2 on PC0-PC2
+#define ADC_OVERSAMPLE_LOG2 4       // 16 conversions per value, at most 6 (the sum is 16-bit)
+#define ADC_EXTRA_BITS 0            // resolution kept above 10 bits, up to ADC_OVERSAMPLE_LOG2 / 2
+
+#define ADC_OVERSAMPLE (1 << ADC_OVERSAMPLE_LOG2)
+
+void adc_init(void);
+void adc_start(void);
+uint8_t adc_latest(uint16_t values[ADC_CHANNELS]);
+uint8_t adc_busy(void);
+
+#endif /* ADC_H_ */
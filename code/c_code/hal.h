@@ -0,0 +1,205 @@
+/*
+Header file for the hardware abstraction layer used by the LCD, UART and keypad/ADC drivers
+
+AVR build (default): every function is a static inline wrapper around the register access the drivers used to
+make directly, so with constant arguments avr-gcc emits the same sbi/cbi/out/in instructions as before.
+Host build (-DHAL_HOST): the same functions are implemented in host_code/hal_host.c, which keeps a model of the
+ports and records SPI bytes, GPIO edges, UART output and requested delays, so the drivers run natively on Linux.
+*/
+
+#ifndef HAL_H_
+#define HAL_H_
+
+#include <stdint.h>
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+#ifndef HAL_HOST
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <util/delay.h>
+
+// a port is named by its PORTx register, DDRx and PINx sit just below it in I/O space on every ATmega port
+typedef volatile uint8_t *hal_port_t;
+#define HAL_PORTB (&PORTB)
+#define HAL_PORTC (&PORTC)
+#define HAL_PORTD (&PORTD)
+#define HAL_DDR(port) (*((port) - 1))
+#define HAL_PIN(port) (*((port) - 2))
+
+// ---------------------------------- GPIO -------------------------------------------
+static inline void hal_gpio_output(hal_port_t port, uint8_t mask) { HAL_DDR(port) |= mask; }
+static inline void hal_gpio_input(hal_port_t port, uint8_t mask) { HAL_DDR(port) &= ~mask; }
+static inline void hal_gpio_high(hal_port_t port, uint8_t mask) { *port |= mask; }
+static inline void hal_gpio_low(hal_port_t port, uint8_t mask) { *port &= ~mask; }
+static inline uint8_t hal_gpio_read(hal_port_t port) { return HAL_PIN(port); }
+
+// ---------------------------------- SPI0 (master) ----------------------------------
+static inline void hal_spi_init(void)
+{
+    SPCR0 |= (1 << SPE) | (1 << MSTR);     // enable, master, fck/4 ...
+    SPSR0 |= (1 << SPI2X);                  // ... doubled to fck/2 = 8 MHz
+}
+
+static inline void hal_spi_write(uint8_t data)
+{
+    SPDR0 = data;
+    while (!(SPSR0 & (1 << SPIF)));
+}
+
+// ---------------------------------- Timer0 PWM on OC0A (PD6) -----------------------
+static inline void hal_pwm0a_init(uint8_t duty)
+{
+    TCCR0A |= (1 << COM0A1) | (1 << WGM01) | (1 << WGM00);    // non-inverting fast PWM, TOP = 0xFF
+    TCCR0B |= (1 << CS02);                                    // /256 prescaler, 244 Hz
+    OCR0A = duty;
+}
+
+// 0 is fully off: fast PWM would still pulse for one count, so the output is disconnected and Timer0 stopped
+static inline void hal_pwm0a_set(uint8_t duty)
+{
+    OCR0A = duty;
+    if (duty) {
+        TCCR0A |= (1 << COM0A1);
+        TCCR0B |= (1 << CS02);
+    } else {
+        TCCR0A &= ~(1 << COM0A1);   // PD6 follows PORTD again, which is low
+        TCCR0B &= ~(1 << CS02);
+    }
+}
+
+// ---------------------------------- USART0 -----------------------------------------
+static inline void hal_uart_init(uint16_t ubrr, uint8_t double_speed, uint8_t two_stop_bits)
+{
+    UBRR0H = (uint8_t)(ubrr >> 8);
+    UBRR0L = (uint8_t)ubrr;
+    UCSR0A = double_speed ? (1 << U2X0) : 0;    // divide by 8 instead of 16
+    UCSR0B = (1 << RXEN0) | (1 << TXEN0);
+    UCSR0C = (1 << UCSZ01) | (1 << UCSZ00) | (two_stop_bits ? (1 << USBS0) : 0);   // 8 data bits
+}
+
+static inline void hal_uart_write(uint8_t data)
+{
+    while (!(UCSR0A & (1 << UDRE0)));
+    UDR0 = data;
+}
+
+static inline uint8_t hal_uart_ready(void) { return UCSR0A & (1 << RXC0); }
+
+static inline uint8_t hal_uart_read(void)
+{
+    while (!(UCSR0A & (1 << RXC0)));
+    return UDR0;
+}
+
+// ---------------------------------- ADC --------------------------------------------
+static inline void hal_adc_init(void)
+{
+    ADMUX = (1 << REFS0);                                                  // AVCC reference
+    ADCSRA = (1 << ADEN) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);     // /128 = 125 kHz
+}
+
+static inline uint16_t hal_adc_read(uint8_t channel)
+{
+    ADMUX = (ADMUX & 0xF8) | (channel & 0x07);
+    _delay_us(10);                  // let the multiplexer settle
+    ADCSRA |= (1 << ADSC);
+    while (ADCSRA & (1 << ADSC));
+    return ADC;
+}
+
+// ---------------------------------- delays -----------------------------------------
+static inline void hal_delay_ms(uint16_t ms)
+{
+    while (ms--)
+        _delay_ms(1);
+}
+
+#define hal_delay_us(us) _delay_us(us)     // compile-time constant only, like _delay_us()
+
+#else /* HAL_HOST */
+
+// flash tables are ordinary const data on the host
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+
+typedef uint8_t hal_port_t;
+#define HAL_PORTB 0
+#define HAL_PORTC 1
+#define HAL_PORTD 2
+#define HAL_PORT_COUNT 3
+
+// pin numbers as <avr/io.h> names them
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PC0 0
+#define PC1 1
+#define PC2 2
+#define PC3 3
+#define PC4 4
+#define PC5 5
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+
+void hal_gpio_output(hal_port_t port, uint8_t mask);
+void hal_gpio_input(hal_port_t port, uint8_t mask);
+void hal_gpio_high(hal_port_t port, uint8_t mask);
+void hal_gpio_low(hal_port_t port, uint8_t mask);
+uint8_t hal_gpio_read(hal_port_t port);
+
+void hal_spi_init(void);
+void hal_spi_write(uint8_t data);
+
+void hal_pwm0a_init(uint8_t duty);
+void hal_pwm0a_set(uint8_t duty);
+
+void hal_uart_init(uint16_t ubrr, uint8_t double_speed, uint8_t two_stop_bits);
+void hal_uart_write(uint8_t data);
+uint8_t hal_uart_ready(void);
+uint8_t hal_uart_read(void);
+
+void hal_adc_init(void);
+uint16_t hal_adc_read(uint8_t channel);
+
+void hal_delay_ms(uint16_t ms);
+void hal_delay_us(uint16_t us);
+
+// what the host backend has recorded since hal_host_reset()
+typedef struct {
+    uint32_t spi_bytes;
+    uint32_t gpio_edges;        // output bits that changed level
+    uint32_t uart_bytes;
+    uint64_t delay_us;          // time the drivers asked to wait
+    uint8_t pwm0a;              // last backlight duty
+} hal_host_stats_t;
+
+extern hal_host_stats_t hal_host_stats;
+
+// optional observers and input models, NULL by default
+extern void (*hal_host_spi_hook)(uint8_t data);
+extern void (*hal_host_uart_hook)(uint8_t data);
+extern uint8_t (*hal_host_pin_hook)(hal_port_t port, uint8_t latch);   // PINx given the PORTx latch
+
+void hal_host_reset(void);
+uint8_t hal_host_latch(hal_port_t port);
+void hal_host_set_pins(hal_port_t port, uint8_t value);
+void hal_host_set_adc(uint8_t channel, uint16_t value);
+void hal_host_uart_input(const char *text);
+
+#endif /* HAL_HOST */
+
+#endif /* HAL_H_ */
@@ -0,0 +1,283 @@
+/*
+Interrupt-driven keypad scanner with per-key debounce and an event ring
+*/
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include "hal.h"
+#include "keypad.h"
+
+#define KEYPAD_TIMER_TOP ((F_CPU / 64 / 1000UL) * KEYPAD_TICK_MS - 1)    // Timer0 counts at F_CPU / 64
+#define KEYPAD_REPEAT_DELAY_SCANS (KEYPAD_REPEAT_DELAY_MS / KEYPAD_SCAN_MS)
+#define KEYPAD_REPEAT_SCANS (KEYPAD_REPEAT_MS / KEYPAD_SCAN_MS)
+
+#if KEYPAD_TIMER_TOP > 255
+#error "KEYPAD_TICK_MS too long for the 8-bit Timer0"
+#endif
+#if KEYPAD_REPEAT_DELAY_SCANS > 255
+#error "KEYPAD_REPEAT_DELAY_MS too long for the 8-bit hold counter"
+#endif
+
+// port masks from the pin map in keypad.h, all compile-time constants
+#define PORT_B 0
+#define PORT_C 1
+#define PORT_D 2
+#define MASK_ON_B(port, pin) | ((PORT_##port == PORT_B) ? (1 << pin) : 0)
+#define MASK_ON_C(port, pin) | ((PORT_##port == PORT_C) ? (1 << pin) : 0)
+#define MASK_ON_D(port, pin) | ((PORT_##port == PORT_D) ? (1 << pin) : 0)
+
+#define ROW_MASK_B (0 KEYPAD_ROW_PINS(MASK_ON_B))
+#define ROW_MASK_C (0 KEYPAD_ROW_PINS(MASK_ON_C))
+#define ROW_MASK_D (0 KEYPAD_ROW_PINS(MASK_ON_D))
+#define COL_MASK_B (0 KEYPAD_COL_PINS(MASK_ON_B))
+#define COL_MASK_C (0 KEYPAD_COL_PINS(MASK_ON_C))
+#define COL_MASK_D (0 KEYPAD_COL_PINS(MASK_ON_D))
+
+// pin-change interrupts on the column ports: PCINT bit n of PCMSK0/1/2 is pin n of port B/C/D
+#define PCINT_PORTS ((COL_MASK_B ? 1 << PCIE0 : 0) | (COL_MASK_C ? 1 << PCIE1 : 0) | (COL_MASK_D ? 1 << PCIE2 : 0))
+
+#if KEYPAD_COLS > 8
+#error "at most 8 keypad columns"
+#endif
+
+// per-key debounce states
+#define KEY_UP 0
+#define KEY_PRESSING 1      // read down, waiting for KEYPAD_DEBOUNCE scans in a row
+#define KEY_DOWN 2
+#define KEY_RELEASING 3     // read up, waiting for KEYPAD_DEBOUNCE scans in a row
+
+// row pins as (port << 3) | pin, ROW1 first
+#define ROW_ENTRY(port, pin) (PORT_##port << 3) | pin,
+static const uint8_t row_pins[KEYPAD_ROWS] PROGMEM = {KEYPAD_ROW_PINS(ROW_ENTRY)};
+
+static const uint8_t keymap[] PROGMEM = KEYPAD_KEYMAP;
+_Static_assert(sizeof(keymap) == KEYPAD_KEYS, "KEYPAD_KEYMAP needs one key per row and column");
+
+// ISR state
+static uint8_t state[KEYPAD_KEYS];
+static uint8_t count[KEYPAD_KEYS];      // debounce scans while PRESSING/RELEASING, hold scans while DOWN
+static uint8_t scan_row = 0;            // row driven low, read on the next tick
+static uint8_t keys_busy = 0;           // keys not UP, seen during the current scan
+
+// events: head is written by the ISR, tail by keypad_get()
+static keypad_event_t events[KEYPAD_EVENTS];
+static volatile uint8_t event_head = 0;
+static volatile uint8_t event_tail = 0;
+
+volatile uint8_t keypad_dropped = 0;
+
+// all rows HIGH except row, which is driven LOW
+static void row_drive(uint8_t row)
+{
+    static const hal_port_t ports[] = {HAL_PORTB, HAL_PORTC, HAL_PORTD};
+    uint8_t entry = pgm_read_byte(&row_pins[row]);
+
+    if (ROW_MASK_B) hal_gpio_high(HAL_PORTB, ROW_MASK_B);
+    if (ROW_MASK_C) hal_gpio_high(HAL_PORTC, ROW_MASK_C);
+    if (ROW_MASK_D) hal_gpio_high(HAL_PORTD, ROW_MASK_D);
+    hal_gpio_low(ports[entry >> 3], 1 << (entry & 0x07));
+}
+
+// drives every row LOW, so any key pulls its column low
+static void rows_all_low(void)
+{
+    if (ROW_MASK_B) hal_gpio_low(HAL_PORTB, ROW_MASK_B);
+    if (ROW_MASK_C) hal_gpio_low(HAL_PORTC, ROW_MASK_C);
+    if (ROW_MASK_D) hal_gpio_low(HAL_PORTD, ROW_MASK_D);
+}
+
+// bit per column pulled low by a pressed key, bit0 = COL1: one read per port with columns on it, then the
+// column bits are shifted in from the pin map (unrolled, no table walk)
+#define COLUMN_SHIFT_IN(port, pin) columns = (columns >> 1) | ((pin_##port & (1 << pin)) ? 0 : 0x80);
+
+static uint8_t columns_read(void)
+{
+    uint8_t pin_B = COL_MASK_B ? hal_gpio_read(HAL_PORTB) : 0xFF;
+    uint8_t pin_C = COL_MASK_C ? hal_gpio_read(HAL_PORTC) : 0xFF;
+    uint8_t pin_D = COL_MASK_D ? hal_gpio_read(HAL_PORTD) : 0xFF;
+    uint8_t columns = 0;
+
+    (void)pin_B;
+    (void)pin_C;
+    (void)pin_D;
+    KEYPAD_COL_PINS(COLUMN_SHIFT_IN)
+    return columns >> (8 - KEYPAD_COLS);
+}
+
+static void push(uint8_t key, uint8_t type)
+{
+    uint8_t next = (event_head + 1) & (KEYPAD_EVENTS - 1);
+
+    if (next == event_tail) {
+        keypad_dropped++;
+        return;
+    }
+    events[event_head].key = key;
+    events[event_head].type = type;
+    event_head = next;
+}
+
+static void debounce(uint8_t index, uint8_t down)
+{
+    switch (state[index]) {
+    case KEY_UP:
+        if (down) {
+            state[index] = KEY_PRESSING;
+            count[index] = 1;
+        }
+        break;
+    case KEY_PRESSING:
+        if (!down)
+            state[index] = KEY_UP;
+        else if (++count[index] >= KEYPAD_DEBOUNCE) {
+            state[index] = KEY_DOWN;
+            count[index] = 0;
+            push(pgm_read_byte(&keymap[index]), KEYPAD_PRESS);
+        }
+        break;
+    case KEY_DOWN:
+        if (!down) {
+            state[index] = KEY_RELEASING;
+            count[index] = 1;
+        } else if (++count[index] >= KEYPAD_REPEAT_DELAY_SCANS) {
+            count[index] = KEYPAD_REPEAT_DELAY_SCANS - KEYPAD_REPEAT_SCANS;
+            push(pgm_read_byte(&keymap[index]), KEYPAD_REPEAT);
+        }
+        break;
+    case KEY_RELEASING:
+        if (down)
+            state[index] = KEY_DOWN;    // a bounce, the hold time starts over
+        else if (++count[index] >= KEYPAD_DEBOUNCE) {
+            state[index] = KEY_UP;
+            push(pgm_read_byte(&keymap[index]), KEYPAD_RELEASE);
+        }
+        break;
+    }
+    if (state[index] != KEY_UP)
+        keys_busy = 1;
+}
+
+#if KEYPAD_PCINT_ARM
+// a column went low: scan from ROW1, its columns are read on the first tick
+static void scan_start(void)
+{
+    PCICR &= ~PCINT_PORTS;
+    scan_row = 0;
+    row_drive(scan_row);
+    keys_busy = 0;
+    TCNT0 = 0;
+    TCCR0B = (1 << CS01) | (1 << CS00);
+}
+
+// every key up: drive all rows low, stop the timer and let a column edge start the next scan
+static void arm(void)
+{
+    TCCR0B = 0;
+    rows_all_low();
+    PCIFR = PCINT_PORTS;    // PCIFn sit at the same bits as PCIEn
+    PCICR |= PCINT_PORTS;
+
+    // a key pressed since its row was last read pulled its column low before the flags were cleared
+    if (columns_read())
+        scan_start();
+}
+
+#if COL_MASK_B
+ISR(PCINT0_vect)
+{
+    scan_start();
+}
+#endif
+#if COL_MASK_C
+ISR(PCINT1_vect)
+{
+    scan_start();
+}
+#endif
+#if COL_MASK_D
+ISR(PCINT2_vect)
+{
+    scan_start();
+}
+#endif
+#endif
+
+ISR(TIMER0_COMPA_vect)
+{
+    uint8_t columns = columns_read();
+    uint8_t index = scan_row * KEYPAD_COLS;
+
+    for (uint8_t col = 0; col < KEYPAD_COLS; col++, columns >>= 1)
+        debounce(index + col, columns & 1);
+
+    if (++scan_row == KEYPAD_ROWS) {
+        scan_row = 0;
+#if KEYPAD_PCINT_ARM
+        if (!keys_busy) {
+            arm();
+            return;
+        }
+#endif
+        keys_busy = 0;
+    }
+    row_drive(scan_row);
+}
+
+// Keypad pins: Rows: PB1,PD2,PD3,PD4  Cols: PD5,PD6,PD7,PB0
+void keypad_init(void)
+{
+    TCCR0B = 0;
+#if KEYPAD_PCINT_ARM
+    PCICR &= ~PCINT_PORTS;
+#endif
+
+    // Configure columns as inputs with pullups
+    hal_gpio_input(HAL_PORTB, COL_MASK_B);
+    hal_gpio_high(HAL_PORTB, COL_MASK_B);
+    hal_gpio_input(HAL_PORTC, COL_MASK_C);
+    hal_gpio_high(HAL_PORTC, COL_MASK_C);
+    hal_gpio_input(HAL_PORTD, COL_MASK_D);
+    hal_gpio_high(HAL_PORTD, COL_MASK_D);
+
+    // Configure rows as outputs, ROW1 driven low for the first tick
+    hal_gpio_output(HAL_PORTB, ROW_MASK_B);
+    hal_gpio_output(HAL_PORTC, ROW_MASK_C);
+    hal_gpio_output(HAL_PORTD, ROW_MASK_D);
+    scan_row = 0;
+    row_drive(scan_row);
+
+    for (uint8_t i = 0; i < KEYPAD_KEYS; i++)
+        state[i] = KEY_UP;
+    keys_busy = 0;
+    event_tail = event_head;
+
+#if KEYPAD_PCINT_ARM
+    PCMSK0 |= COL_MASK_B;
+    PCMSK1 |= COL_MASK_C;
+    PCMSK2 |= COL_MASK_D;
+#endif
+
+    // Timer0 CTC, one row per KEYPAD_TICK_MS
+    TCCR0A = (1 << WGM01);
+    OCR0A = KEYPAD_TIMER_TOP;
+    TCNT0 = 0;
+    TIMSK0 = (1 << OCIE0A);
+    TCCR0B = (1 << CS01) | (1 << CS00);     // /64
+    sei();
+}
+
+// scanner stopped: every key up with the columns armed, or keypad_init() not called yet
+uint8_t keypad_idle(void)
+{
+    return TCCR0B == 0;
+}
+
+// takes the oldest event, returns 0 if there is none
+uint8_t keypad_get(keypad_event_t *event)
+{
+    if (event_tail == event_head)
+        return 0;
+    *event = events[event_tail];
+    event_tail = (event_tail + 1) & (KEYPAD_EVENTS - 1);
+    return 1;
+}
@@ -0,0 +1,76 @@
+/*
+Header file for the interrupt-driven 4x4 keypad scanner on the keypad MCU
+
+Timer0 interrupts every KEYPAD_TICK_MS and scans one row per tick: it reads the columns of the row it drove
+low on the previous tick (so the lines have had a whole tick to settle, no busy-wait) and then drives the next
+row. Every key has its own debounce state machine, and presses, releases and auto-repeats go into an event
+ring that keypad_get() drains, so a key is never lost between two polls of the main loop.
+
+With KEYPAD_PCINT_ARM the scan stops once every key is up: all rows are driven low and a pin-change interrupt
+on any column (PCINT21-23 on PD5-PD7, PCINT0 on PB0 as wired) starts it again, so an idle keypad costs no
+interrupts.
+
+A press is reported KEYPAD_DEBOUNCE full scans after the contacts settle, at most
+KEYPAD_ROWS * KEYPAD_TICK_MS * (KEYPAD_DEBOUNCE + 1) = 16 ms.
+
+The wiring and the key layout are the tables below; keypad.c builds its port masks and the column decode
+from them at compile time, so another keypad is a table edit. Rows and columns can sit on ports B, C and D.
+*/
+
+#ifndef KEYPAD_H_
+#define KEYPAD_H_
+
+#include <stdint.h>
+
+#ifndef KEYPAD_PCINT_ARM
+#define KEYPAD_PCINT_ARM 1
+#endif
+
+// key codes: digits are their value
+#define KEYPAD_KEY_A 10
+#define KEYPAD_KEY_B 11
+#define KEYPAD_KEY_C 12
+#define KEYPAD_KEY_D 13
+#define KEYPAD_KEY_STAR 14
+#define KEYPAD_KEY_HASH 15
+
+// pin map, X(port letter, pin): rows are driven low one at a time, columns read with pull-ups
+#define KEYPAD_ROW_PINS(X) X(B, PB1) X(D, PD2) X(D, PD3) X(D, PD4)        // ROW1-ROW4
+#define KEYPAD_COL_PINS(X) X(D, PD5) X(D, PD6) X(D, PD7) X(B, PB0)        // COL1-COL4
+
+// key code at each row and column, ROW1 first
+#define KEYPAD_KEYMAP {                                             \
+    1,               2, 3,               KEYPAD_KEY_A,              \
+    4,               5, 6,               KEYPAD_KEY_B,              \
+    7,               8, 9,               KEYPAD_KEY_C,              \
+    KEYPAD_KEY_STAR, 0, KEYPAD_KEY_HASH, KEYPAD_KEY_D,              \
+}
+
+#define KEYPAD_PIN_COUNT(port, pin) + 1
+#define KEYPAD_ROWS (0 KEYPAD_ROW_PINS(KEYPAD_PIN_COUNT))
+#define KEYPAD_COLS (0 KEYPAD_COL_PINS(KEYPAD_PIN_COUNT))
+#define KEYPAD_KEYS (KEYPAD_ROWS * KEYPAD_COLS)
+#define KEYPAD_TICK_MS 1
+#define KEYPAD_SCAN_MS (KEYPAD_ROWS * KEYPAD_TICK_MS)
+#define KEYPAD_DEBOUNCE 3                   // scans a key must read the same before it changes state
+#define KEYPAD_REPEAT_DELAY_MS 500          // held this long before the first repeat
+#define KEYPAD_REPEAT_MS 100                // then one repeat this often
+#define KEYPAD_EVENTS 16                    // event ring size, power of 2
+
+// event types
+#define KEYPAD_PRESS 1
+#define KEYPAD_RELEASE 2
+#define KEYPAD_REPEAT 3
+
+typedef struct {
+    uint8_t key;
+    uint8_t type;
+} keypad_event_t;
+
+extern volatile uint8_t keypad_dropped;     // events lost to a full ring
+
+void keypad_init(void);
+uint8_t keypad_get(keypad_event_t *event);
+uint8_t keypad_idle(void);
+
+#endif /* KEYPAD_H_ */
@@ -0,0 +1,87 @@
+/*
+Knob position filter with hysteresis zones
+*/
+#include <stdlib.h>
+#include "knob.h"
+
+#if KNOB_LEAVE < KNOB_ENTER
+#error "KNOB_LEAVE must not be inside KNOB_ENTER"
+#endif
+#if ADC_EXTRA_BITS
+#error "knob targets and bands are 10-bit ADC counts"
+#endif
+
+#define KNOB_FRACTION 4         // fixed-point bits kept in the IIR state
+
+typedef struct {
+    uint16_t target;
+    uint16_t history[2];        // the two readings before this one, for the median
+    uint16_t filtered;          // IIR state, KNOB_FRACTION fractional bits
+    uint32_t since;             // timebase_ms() of the last zone change
+} knob_t;
+
+static knob_t knobs[KNOB_COUNT];
+static knob_event_t on_event;
+static uint8_t zones = 0;       // bit per knob in its zone
+static uint8_t started = 0;     // the filters have been seeded
+
+static uint16_t median3(uint16_t a, uint16_t b, uint16_t c)
+{
+    if (a > b) { uint16_t t = a; a = b; b = t; }
+    if (b > c) b = c;
+    return (a > b) ? a : b;
+}
+
+// starts over with new targets, the next reading seeds the filters
+void knob_init(const uint16_t targets[KNOB_COUNT], knob_event_t handler)
+{
+    for (uint8_t i = 0; i < KNOB_COUNT; i++)
+        knobs[i].target = targets[i];
+    on_event = handler;
+    zones = 0;
+    started = 0;
+}
+
+void knob_update(const uint16_t values[KNOB_COUNT], uint32_t now)
+{
+    for (uint8_t i = 0; i < KNOB_COUNT; i++) {
+        knob_t *knob = &knobs[i];
+        uint16_t value = values[i];
+        uint8_t bit = 1 << i;
+
+        if (!started) {
+            knob->history[0] = knob->history[1] = value;
+            knob->filtered = value << KNOB_FRACTION;
+            knob->since = now;
+        }
+
+        uint16_t median = median3(knob->history[0], knob->history[1], value);
+        knob->history[0] = knob->history[1];
+        knob->history[1] = value;
+        knob->filtered += ((int16_t)(median << KNOB_FRACTION) - (int16_t)knob->filtered) >> KNOB_IIR_SHIFT;
+
+        uint16_t distance = abs((int16_t)knob_position(i) - (int16_t)knob->target);
+        uint8_t inside = (zones & bit) ? (distance <= KNOB_LEAVE) : (distance <= KNOB_ENTER);
+
+        if (inside != !!(zones & bit)) {
+            uint32_t dwell = started ? now - knob->since : 0;
+            zones ^= bit;
+            knob->since = now;
+            if (on_event)
+                on_event(i, inside, (dwell > 0xFFFF) ? 0xFFFF : dwell);
+        }
+    }
+    started = 1;
+}
+
+// bit per knob in its zone, bit0-2 ADC0-2
+uint8_t knob_zones(void)
+{
+    return zones;
+}
+
+// filtered position in ADC counts
+uint16_t knob_position(uint8_t knob)
+{
+    return (knobs[knob].filtered + (1 << (KNOB_FRACTION - 1))) >> KNOB_FRACTION;
+}
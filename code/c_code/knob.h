@@ -0,0 +1,32 @@
+/*
+Header file for the knob position filter on the keypad MCU
+
+Each knob's ADC readings (adc_latest()) go through a median of the last 3, which throws out single spikes,
+and then a first-order IIR low-pass. The filtered position is compared with the knob's combination target
+through a hysteresis band: a knob enters its zone within KNOB_ENTER of the target and only leaves it beyond
+KNOB_LEAVE, so a reading sitting on the edge can't flicker in and out.
+
+knob_update() calls the event handler only when a knob enters or leaves its zone, with the time it spent in
+the previous state, so the combination check runs on changes rather than on every sample.
+*/
+
+#ifndef KNOB_H_
+#define KNOB_H_
+
+#include <stdint.h>
+#include "adc.h"
+
+#define KNOB_COUNT ADC_CHANNELS
+#define KNOB_ENTER 90           // ADC counts from the target to enter the zone
+#define KNOB_LEAVE 110          // ... and to leave it again
+#define KNOB_IIR_SHIFT 2        // low-pass weight of a new reading, 1/4 (time constant ~4 samples)
+
+// knob entered (1) or left (0) its zone after dwell_ms in the other state (0 on the first reading)
+typedef void (*knob_event_t)(uint8_t knob, uint8_t entered, uint16_t dwell_ms);
+
+void knob_init(const uint16_t targets[KNOB_COUNT], knob_event_t handler);
+void knob_update(const uint16_t values[KNOB_COUNT], uint32_t now);
+uint8_t knob_zones(void);
+uint16_t knob_position(uint8_t knob);
+
+#endif /* KNOB_H_ */
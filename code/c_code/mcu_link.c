@@ -0,0 +1,293 @@
+/*
+Multi-master TWI message link between the two ATmegas
+*/
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <util/crc16.h>
+#include "mcu_link.h"
+#include "timebase.h"
+
+#define MCU_LINK_TWBR (((F_CPU / MCU_LINK_SCL_HZ) - 16) / 2)
+
+// TWCR values: idle with the slave address enabled, and the same plus START/STOP
+#define TWCR_IDLE ((1 << TWINT) | (1 << TWEN) | (1 << TWIE) | (1 << TWEA))
+#define TWCR_NACK ((1 << TWINT) | (1 << TWEN) | (1 << TWIE))
+#define TWCR_START (TWCR_IDLE | (1 << TWSTA))
+#define TWCR_STOP (TWCR_IDLE | (1 << TWSTO))
+
+volatile uint8_t mcu_link_crc_errors = 0;
+volatile uint8_t mcu_link_dropped = 0;
+
+static uint8_t peer = 0;
+static uint8_t next_seq = 0;
+static volatile uint8_t acked_seq = 0;
+static volatile uint8_t ack_count = 0;      // bumped on every ACK received
+
+// outgoing frames: head is written by the main loop, tail by the ISR once the peer took the frame
+static uint8_t tx_queue[MCU_LINK_QUEUE][MCU_LINK_FRAME_SIZE];
+static volatile uint8_t tx_head = 0;
+static volatile uint8_t tx_tail = 0;
+static volatile uint8_t tx_busy = 0;        // master transaction in progress
+static uint8_t tx_index = 0;
+static volatile uint8_t tx_refused = 0;     // the frame at tx_tail has been NACKed, kick() waits for retry_at
+static uint32_t refused_since;              // timebase_ms() of its first NACK
+static volatile uint32_t retry_at;
+static uint8_t retry_ms;                    // next back-off
+
+// incoming frames: head is written by the ISR, tail by the main loop
+static mcu_msg_t rx_queue[MCU_LINK_QUEUE];
+static volatile uint8_t rx_head = 0;
+static volatile uint8_t rx_tail = 0;
+static uint8_t rx_buf[MCU_LINK_FRAME_SIZE];
+static uint8_t rx_index = 0;
+static volatile uint8_t rx_busy = 0;        // addressed as slave, frame still coming in
+
+void mcu_link_init(uint8_t own_addr, uint8_t peer_addr)
+{
+    peer = peer_addr;
+
+    PORTC |= (1 << PC4) | (1 << PC5);   // internal pull-ups on SDA/SCL
+    TWSR0 = 0;                          // prescaler 1
+    TWBR0 = MCU_LINK_TWBR;
+    TWAR0 = own_addr << 1;              // no general call
+    TWCR0 = TWCR_IDLE;
+
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sei();
+}
+
+static uint8_t frame_crc(const uint8_t *frame)
+{
+    uint8_t crc = 0;
+    for (uint8_t i = 0; i < MCU_LINK_FRAME_SIZE - 1; i++)
+        crc = _crc8_ccitt_update(crc, frame[i]);
+    return crc;
+}
+
+// starts a master transaction if a frame is waiting, the TWI is idle and any back-off has run out
+static void kick(void)
+{
+    uint32_t now = timebase_ms();
+    uint8_t sreg = SREG;
+    cli();
+    if (!tx_busy && tx_tail != tx_head && (!tx_refused || (int32_t)(now - retry_at) >= 0)) {
+        tx_busy = 1;
+        tx_index = 0;
+        TWCR0 = TWCR_START;
+    }
+    SREG = sreg;
+}
+
+// queues a message, sleeping while the queue is full; returns its sequence number
+uint8_t mcu_link_send(uint8_t type, uint8_t arg)
+{
+    uint8_t head = tx_head;
+    uint8_t next = (head + 1) & (MCU_LINK_QUEUE - 1);
+
+    while (next == tx_tail) {
+        kick();
+        sleep_mode();       // woken by the TWI or the 1 ms timebase tick
+    }
+
+    uint8_t seq = next_seq++;
+    tx_queue[head][0] = type;
+    tx_queue[head][1] = seq;
+    tx_queue[head][2] = arg;
+    tx_queue[head][3] = frame_crc(tx_queue[head]);
+    tx_head = next;
+
+    kick();
+    return seq;
+}
+
+// sends a message and waits for the other MCU to acknowledge it; returns 0 on timeout
+uint8_t mcu_link_send_wait(uint8_t type, uint8_t arg, uint16_t timeout_ms)
+{
+    uint8_t acks = ack_count;
+    uint8_t seq = mcu_link_send(type, arg);
+    uint32_t start = timebase_ms();
+
+    while (timebase_ms() - start < timeout_ms) {
+        // only ACKs that arrived after sending count, acked_seq may be left over from long ago
+        if (ack_count != acks && acked_seq == seq)
+            return 1;
+        kick();
+        sleep_mode();
+    }
+    return 0;
+}
+
+// tells the sender that msg has been handled
+void mcu_link_ack(const mcu_msg_t *msg)
+{
+    mcu_link_send(MCU_MSG_ACK, msg->seq);
+}
+
+// returns 1 if the latest ACK received was for seq, for senders that don't wait (one message in flight at a time)
+uint8_t mcu_link_acked(uint8_t seq)
+{
+    return ack_count && acked_seq == seq;
+}
+
+// returns 1 and copies the oldest message if one is waiting
+uint8_t mcu_link_poll(mcu_msg_t *msg)
+{
+    kick();     // retries anything the peer NACKed
+
+    uint8_t tail = rx_tail;
+    if (tail == rx_head)
+        return 0;
+
+    *msg = rx_queue[tail];
+    rx_tail = (tail + 1) & (MCU_LINK_QUEUE - 1);
+    return 1;
+}
+
+// sleeps (idle mode) until a message arrives; returns 0 on timeout, timeout_ms = 0 waits forever
+uint8_t mcu_link_wait(mcu_msg_t *msg, uint16_t timeout_ms)
+{
+    uint32_t start = timebase_ms();
+
+    while (!mcu_link_poll(msg)) {
+        if (timeout_ms && timebase_ms() - start >= timeout_ms)
+            return 0;
+        sleep_mode();
+    }
+    return 1;
+}
+
+// drops every message received so far
+void mcu_link_flush(void)
+{
+    rx_tail = rx_head;
+}
+
+// frames queued either way or a transfer in progress: the TWI only recognises its address while powered down
+uint8_t mcu_link_busy(void)
+{
+    return tx_busy || tx_tail != tx_head || rx_tail != rx_head || rx_busy;
+}
+
+// ISR context: a complete frame arrived as slave
+static void frame_received(void)
+{
+    if (rx_index != MCU_LINK_FRAME_SIZE || frame_crc(rx_buf) != rx_buf[MCU_LINK_FRAME_SIZE - 1]) {
+        mcu_link_crc_errors++;
+        return;
+    }
+
+    if (rx_buf[0] == MCU_MSG_ACK) {
+        acked_seq = rx_buf[2];
+        ack_count++;
+        return;
+    }
+
+    uint8_t head = rx_head;
+    rx_queue[head].type = rx_buf[0];
+    rx_queue[head].seq = rx_buf[1];
+    rx_queue[head].arg = rx_buf[2];
+    rx_head = (head + 1) & (MCU_LINK_QUEUE - 1);
+}
+
+// ISR context: finish the master transaction, START again right away if more frames are queued
+static uint8_t master_done(uint8_t sent)
+{
+    uint32_t now = timebase_ms();
+
+    if (!sent && !tx_refused) {
+        tx_refused = 1;
+        refused_since = now;
+        retry_ms = MCU_LINK_RETRY_MS;
+    }
+
+    if (sent) {
+        tx_tail = (tx_tail + 1) & (MCU_LINK_QUEUE - 1);
+        tx_refused = 0;
+    } else if (now - refused_since >= MCU_LINK_GIVE_UP_MS) {
+        tx_tail = (tx_tail + 1) & (MCU_LINK_QUEUE - 1);
+        tx_refused = 0;
+        mcu_link_dropped++;
+    } else {
+        // peer busy or not listening yet, kick() retries from the main loop once the back-off has run out
+        retry_at = now + retry_ms;
+        if (retry_ms < MCU_LINK_RETRY_MAX_MS)
+            retry_ms <<= 1;
+        tx_busy = 0;
+        return TWCR_STOP;
+    }
+
+    if (tx_tail != tx_head) {
+        tx_index = 0;
+        return TWCR_STOP | (1 << TWSTA);
+    }
+    tx_busy = 0;
+    return TWCR_STOP;
+}
+
+ISR(TWI0_vect)
+{
+    uint8_t control = TWCR_IDLE;
+
+    switch (TWSR0 & 0xF8) {
+    // ---- master transmitter ----
+    case 0x08:  // START sent
+    case 0x10:  // repeated START sent
+        TWDR0 = peer << 1;
+        break;
+    case 0x18:  // SLA+W ACKed
+    case 0x28:  // data ACKed
+        if (tx_index < MCU_LINK_FRAME_SIZE)
+            TWDR0 = tx_queue[tx_tail][tx_index++];
+        else
+            control = master_done(1);
+        break;
+    case 0x20:  // SLA+W NACKed
+    case 0x30:  // data NACKed
+        control = master_done(0);
+        break;
+    case 0x38:  // arbitration lost, START again once the bus is free
+        tx_index = 0;
+        control = TWCR_START;
+        break;
+
+    // ---- slave receiver ----
+    case 0x68:  // arbitration lost to the peer addressing us
+        tx_index = 0;
+        // fall through
+    case 0x60:  // own SLA+W received
+        rx_index = 0;
+        rx_busy = 1;
+        // refuse the data while the queue is full, the sender retries
+        if (((rx_head + 1) & (MCU_LINK_QUEUE - 1)) == rx_tail)
+            control = TWCR_NACK;
+        break;
+    case 0x80:  // data received, ACK returned
+        if (rx_index < MCU_LINK_FRAME_SIZE)
+            rx_buf[rx_index] = TWDR0;
+        rx_index++;
+        break;
+    case 0xA0:  // STOP or repeated START
+        frame_received();
+        // fall through
+    case 0x88:  // data received, NACK returned (frame refused)
+        rx_busy = 0;
+        if (tx_busy)            // resume the START interrupted by 0x68
+            control = TWCR_START;
+        break;
+
+    case 0x00:  // bus error
+        control = TWCR_STOP;
+        tx_busy = 0;
+        rx_busy = 0;
+        break;
+    default:
+        break;
+    }
+
+    TWCR0 = control;
+}
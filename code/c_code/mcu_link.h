@@ -0,0 +1,65 @@
+/*
+Header file for the message link between the two ATmegas
+
+Replaces the 3-bit PC3-PC5 state bus. Both MCUs sit on TWI0 (PC4 = SDA, PC5 = SCL, the wires the state bus
+already used) as multi-master peers: a message is sent by addressing the other MCU as master, and received as
+a slave. The hardware handles arbitration when both start at once. Every message is one 4-byte frame:
+
+    | type | seq | arg | CRC-8 |
+
+CRC-8/CCITT (_crc8_ccitt_update, init 0) covers type..arg. MCU_MSG_ACK frames are consumed by the link itself
+so mcu_link_send_wait() can tell when the other side has handled a message.
+
+A frame the peer NACKs (its receive queue is full, or it is busy as master) is retried on the timebase, not on
+every call: after MCU_LINK_RETRY_MS, then twice as long each time up to MCU_LINK_RETRY_MAX_MS. It is only
+dropped once the peer has refused it for MCU_LINK_GIVE_UP_MS, however often the main loop calls in, so a busy
+peer can't make a STAGE message disappear.
+
+Wiring: PC4 <--> PC4, PC5 <--> PC5, common GND. The internal pull-ups are enabled, which is enough for the short
+bench wires; fit 4.7k pull-ups to 5V on both lines for anything longer. PC3 is no longer used.
+
+The waits sleep in idle mode and rely on the 1 ms timebase tick, so call timebase_init() first.
+*/
+
+#ifndef MCU_LINK_H_
+#define MCU_LINK_H_
+
+#include <avr/io.h>
+#include <stdint.h>
+
+#define MCU_LINK_ADDR_LCD 0x10
+#define MCU_LINK_ADDR_KEYPAD 0x11
+#define MCU_LINK_SCL_HZ 100000UL
+#define MCU_LINK_FRAME_SIZE 4
+#define MCU_LINK_QUEUE 8            // frames buffered each way, power of 2
+#define MCU_LINK_RETRY_MS 1         // wait after the first NACK, doubled after each one since ...
+#define MCU_LINK_RETRY_MAX_MS 32    // ... up to this
+#define MCU_LINK_GIVE_UP_MS 2000    // a frame still NACKed this long after the first NACK is dropped
+
+// message types
+#define MCU_MSG_IDENTITY 1      // LCD -> keypad: arg = identity code (1 = Jeevan, 2 = Yongwoo, 3 = Tomas)
+#define MCU_MSG_STAGE 2         // keypad -> LCD: arg = new vault state, VAULT_* in vault_fsm.h
+#define MCU_MSG_DIGITS 3        // keypad -> LCD: arg = PIN digits entered so far (0-4)
+#define MCU_MSG_KNOBS 4         // keypad -> LCD: arg = controls in position, bit0-2 ADC0-2, bit3-5 SW0-2
+#define MCU_MSG_ACK 6           // either way: arg = seq of the message that was handled (5 was LOCK, now STAGE)
+
+typedef struct {
+    uint8_t type;
+    uint8_t seq;
+    uint8_t arg;
+} mcu_msg_t;
+
+extern volatile uint8_t mcu_link_crc_errors;    // frames discarded for a bad CRC or length
+extern volatile uint8_t mcu_link_dropped;       // frames given up on after MCU_LINK_GIVE_UP_MS of NACKs
+
+void mcu_link_init(uint8_t own_addr, uint8_t peer_addr);
+uint8_t mcu_link_send(uint8_t type, uint8_t arg);
+uint8_t mcu_link_send_wait(uint8_t type, uint8_t arg, uint16_t timeout_ms);
+void mcu_link_ack(const mcu_msg_t *msg);
+uint8_t mcu_link_acked(uint8_t seq);
+uint8_t mcu_link_poll(mcu_msg_t *msg);
+uint8_t mcu_link_wait(mcu_msg_t *msg, uint16_t timeout_ms);
+void mcu_link_flush(void);
+uint8_t mcu_link_busy(void);
+
+#endif /* MCU_LINK_H_ */
@@ -0,0 +1,149 @@
+/*
+Sliding door motor: Timer2 PWM on the H-bridge with ramped, non-blocking moves
+*/
+#include <avr/io.h>
+#include "motor.h"
+#include "sched.h"
+#include "timebase.h"
+
+#define MOTOR_PWM_MODE ((1 << WGM21) | (1 << WGM20))      // fast PWM, TOP = 0xFF
+
+static motor_profile_t move;
+static uint8_t direction;
+static uint32_t start;              // timebase_ms() when the move began
+static motor_done_t on_done;
+static uint8_t task = SCHED_NONE;
+#ifdef MOTOR_SENSE_CHANNEL
+static uint16_t stall_ms;
+#endif
+
+void motor_init(void)
+{
+    // Motor pins output, both low (coasting)
+    DDRD |= (1 << MOTOR_IN1) | (1 << MOTOR_IN2);
+    PORTD &= ~((1 << MOTOR_IN1) | (1 << MOTOR_IN2));
+
+#ifdef MOTOR_END_UP
+    DDRC &= ~(1 << MOTOR_END_UP);
+    PORTC |= (1 << MOTOR_END_UP);
+#endif
+#ifdef MOTOR_END_DOWN
+    DDRC &= ~(1 << MOTOR_END_DOWN);
+    PORTC |= (1 << MOTOR_END_DOWN);
+#endif
+#ifdef MOTOR_SENSE_CHANNEL
+    ADMUX = (1 << REFS0) | MOTOR_SENSE_CHANNEL;                             // AVCC reference
+    ADCSRA = (1 << ADEN) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);     // /128 = 125 kHz
+#endif
+}
+
+// duty at elapsed ms into the move: up from MOTOR_START_DUTY, hold, back down
+static uint8_t profile_duty(uint32_t elapsed)
+{
+    uint8_t low = (MOTOR_START_DUTY < move.duty) ? MOTOR_START_DUTY : move.duty;
+    uint8_t span = move.duty - low;
+    uint32_t left = move.run_ms - elapsed;
+
+    if (elapsed < move.accel_ms)
+        return low + (uint32_t)span * elapsed / move.accel_ms;
+    if (left < move.decel_ms)
+        return low + (uint32_t)span * left / move.decel_ms;
+    return move.duty;
+}
+
+static void finish(uint8_t reason)
+{
+    motor_done_t done = on_done;
+
+    motor_stop();
+    if (done)
+        done(reason);
+}
+
+static void motor_task(void)
+{
+    uint32_t elapsed = timebase_ms() - start;
+
+    if (elapsed >= move.run_ms) {
+        finish(MOTOR_DONE_TIME);
+        return;
+    }
+#ifdef MOTOR_END_UP
+    if (direction == MOTOR_UP && !(PINC & (1 << MOTOR_END_UP))) {
+        finish(MOTOR_DONE_END_STOP);
+        return;
+    }
+#endif
+#ifdef MOTOR_END_DOWN
+    if (direction == MOTOR_DOWN && !(PINC & (1 << MOTOR_END_DOWN))) {
+        finish(MOTOR_DONE_END_STOP);
+        return;
+    }
+#endif
+#ifdef MOTOR_SENSE_CHANNEL
+    // one conversion per tick, started on the previous one, so nothing waits on the ADC
+    if (!(ADCSRA & (1 << ADSC))) {
+        if (elapsed > move.accel_ms && ADC > MOTOR_STALL_ADC)
+            stall_ms += MOTOR_TICK_MS;
+        else
+            stall_ms = 0;
+        if (stall_ms >= MOTOR_STALL_MS) {
+            finish(MOTOR_DONE_STALL);
+            return;
+        }
+        ADCSRA |= (1 << ADSC);
+    }
+#endif
+
+    OCR2B = profile_duty(elapsed);
+}
+
+// starts a move, replacing any move in progress (whose callback is dropped)
+void motor_move(uint8_t dir, const motor_profile_t *profile, motor_done_t done)
+{
+    motor_stop();
+    move = *profile;
+    direction = dir;
+    start = timebase_ms();
+
+    // down: IN2 high and IN1 low for the on-time, so the compare output is inverted
+    if (direction == MOTOR_DOWN) {
+        PORTD |= (1 << MOTOR_IN2);
+        TCCR2A = MOTOR_PWM_MODE | (1 << COM2B1) | (1 << COM2B0);
+    } else {
+        TCCR2A = MOTOR_PWM_MODE | (1 << COM2B1);
+    }
+    OCR2B = profile_duty(0);
+    TCNT2 = 0;
+    TCCR2B = (1 << CS21) | (1 << CS20);     // /32 -> 1.95 kHz
+
+#ifdef MOTOR_SENSE_CHANNEL
+    stall_ms = 0;
+    ADCSRA |= (1 << ADSC);
+#endif
+
+    task = sched_every(motor_task, MOTOR_TICK_MS);
+    if (task == SCHED_NONE) {
+        motor_stop();   // no free slot to end the move with, don't leave the motor running
+        return;
+    }
+    on_done = done;
+}
+
+// function to stop motor: drive off at once, no callback
+void motor_stop(void)
+{
+    if (task != SCHED_NONE)
+        sched_cancel(task);
+    task = SCHED_NONE;
+    on_done = 0;
+
+    TCCR2B = 0;
+    TCCR2A = 0;     // compare output off, PD3 follows PORTD again
+    PORTD &= ~((1 << MOTOR_IN1) | (1 << MOTOR_IN2));
+}
+
+uint8_t motor_busy(void)
+{
+    return task != SCHED_NONE;
+}
@@ -0,0 +1,61 @@
+/*
+Header file for the sliding door motor on the LCD MCU
+
+The H-bridge inputs are IN1 = PD3 and IN2 = PD4 (EN tied to 5V). PD3 is OC2B, so Timer2 (free since the servo
+moved to Timer4) chops IN1 in fast PWM at about 2 kHz: driving up, IN2 is low and IN1 is high for the on-time;
+driving down, IN2 is high and the compare output is inverted so IN1 is low for the on-time. Either way the
+on-time is (duty + 1) / 256.
+
+motor_move() runs a trapezoidal profile without blocking: a sched task every MOTOR_TICK_MS ramps the duty up
+from MOTOR_START_DUTY over accel_ms, holds it, and ramps it back down over the last decel_ms of run_ms. The
+done callback runs from that task (never from an interrupt) when the move ends, with the reason:
+
+- MOTOR_DONE_TIME       run_ms elapsed
+- MOTOR_DONE_END_STOP   the end stop for that direction closed (MOTOR_END_UP / MOTOR_END_DOWN, optional)
+- MOTOR_DONE_STALL      the current sense input stayed above MOTOR_STALL_ADC (MOTOR_SENSE_CHANNEL, optional)
+
+motor_stop() cuts the drive at once and drops the callback. Needs sched_init() and timebase_init().
+*/
+
+#ifndef MOTOR_H_
+#define MOTOR_H_
+
+#include <stdint.h>
+
+#define MOTOR_IN1 PD3               // H-bridge pin 2 (IN1), OC2B
+#define MOTOR_IN2 PD4               // H-bridge pin 7 (IN2)
+
+#define MOTOR_TICK_MS 5
+#define MOTOR_START_DUTY 96         // lowest duty that still gets the door moving
+
+// optional end stops, active low with pull-ups, e.g. on the free PC1/PC2
+// #define MOTOR_END_UP PC1
+// #define MOTOR_END_DOWN PC2
+
+// optional current sense: shunt voltage on a spare ADC input (ADC6 is analog-only on the 328PB)
+// #define MOTOR_SENSE_CHANNEL 6
+#define MOTOR_STALL_ADC 600         // ADC counts that mean the motor is stalled against the end
+#define MOTOR_STALL_MS 30           // ... for this long, not counting the inrush while accelerating
+
+#define MOTOR_UP 0
+#define MOTOR_DOWN 1
+
+#define MOTOR_DONE_TIME 0
+#define MOTOR_DONE_END_STOP 1
+#define MOTOR_DONE_STALL 2
+
+typedef struct {
+    uint8_t duty;           // cruise duty, 255 = full on
+    uint16_t accel_ms;
+    uint16_t run_ms;        // whole move, ramps included
+    uint16_t decel_ms;
+} motor_profile_t;
+
+typedef void (*motor_done_t)(uint8_t reason);
+
+void motor_init(void);
+void motor_move(uint8_t direction, const motor_profile_t *profile, motor_done_t done);
+void motor_stop(void);
+uint8_t motor_busy(void);
+
+#endif /* MOTOR_H_ */
@@ -0,0 +1,96 @@
+/*
+Idle power manager: activity timeouts and power-down between events
+*/
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include "power.h"
+#include "sched.h"
+#include "timebase.h"
+
+static uint16_t dim_after;
+static uint16_t off_after;
+static power_level_t on_level;
+static power_ready_t can_power_down;
+static uint8_t level = POWER_ACTIVE;
+static uint32_t last;                   // timebase_ms() of the last activity
+static volatile uint8_t activity = 0;   // set by power_activity(), taken by power_task()
+
+uint16_t power_downs = 0;
+
+static void set_level(uint8_t next)
+{
+    if (next == level)
+        return;
+    level = next;
+    if (on_level)
+        on_level(next);
+}
+
+// every pass: back to POWER_ACTIVE at once on activity, one step down whenever a timeout runs out
+static void power_task(void)
+{
+    uint32_t now = timebase_ms();
+
+    if (activity) {
+        activity = 0;
+        last = now;
+        set_level(POWER_ACTIVE);
+        return;
+    }
+
+    if (now - last >= off_after)
+        set_level(POWER_OFF);
+    else if (now - last >= dim_after)
+        set_level(POWER_DIM);
+}
+
+void power_init(uint16_t dim_ms, uint16_t off_ms, power_level_t handler, power_ready_t ready)
+{
+    dim_after = dim_ms;
+    off_after = off_ms;
+    on_level = handler;
+    can_power_down = ready;
+    level = POWER_ACTIVE;
+    activity = 0;
+    last = timebase_ms();
+
+    ACSR = (1 << ACD);      // analog comparator, unused on both boards
+
+    sched_every(power_task, 0);
+    sched_set_sleep(power_sleep);
+}
+
+// something happened: full power from the next pass; safe to call from ISRs
+void power_activity(void)
+{
+    activity = 1;
+}
+
+uint8_t power_level(void)
+{
+    return level;
+}
+
+// end of every scheduler pass (sched_set_sleep()): idle mode, or power-down at POWER_OFF once the MCU is ready
+void power_sleep(void)
+{
+    uint8_t deep;
+
+    cli();
+    deep = (level == POWER_OFF && !activity && can_power_down && can_power_down());
+    set_sleep_mode(deep ? SLEEP_MODE_PWR_DOWN : SLEEP_MODE_IDLE);
+    sleep_enable();
+#ifdef BODS
+    if (deep)
+        sleep_bod_disable();    // BOD off while powered down, must come within 3 cycles of the sleep
+#endif
+    sei();
+    sleep_cpu();    // the instruction after sei() always runs, so an interrupt that is already pending wakes it at once
+    sleep_disable();
+
+    if (deep) {
+        power_downs++;
+        set_sleep_mode(SLEEP_MODE_IDLE);    // the link waits in mcu_link.c sleep with sleep_mode()
+    }
+}
@@ -0,0 +1,47 @@
+/*
+Header file for the idle power manager, used on both MCUs
+
+sched_run() already sleeps in idle mode between passes. On top of that the power manager times how long it has
+been since the last power_activity() and steps down through three levels, calling the handler given to
+power_init() on every change:
+
+- POWER_ACTIVE  activity within dim_ms
+- POWER_DIM     quiet for dim_ms
+- POWER_OFF     quiet for off_ms
+
+What a level means is up to the handler: the LCD MCU dims the backlight and puts the ST7735 into idle mode, then
+turns the backlight off and the panel to sleep. power_activity() is safe to call from interrupts and brings the
+level straight back to POWER_ACTIVE on the next scheduler pass, within a millisecond in idle mode.
+
+At POWER_OFF, and only while the ready function returns 1, the MCU powers down instead of idling. Power-down stops
+every clock, so:
+- the 1 ms timebase stands still (timebase_ms() does not count the time asleep)
+- the USART, the ADC and every timer but an asynchronous Timer2 stop
+- only a TWI address match, a pin change or INT0/INT1 wakes it, after the crystal start-up time (16K CK = 1 ms
+  with the low-power crystal fuses)
+The ready function is called with interrupts off right before sleeping, so it must only look at state. Pass 0
+to stay in idle mode.
+
+Needs timebase_init() and sched_init() first.
+*/
+
+#ifndef POWER_H_
+#define POWER_H_
+
+#include <stdint.h>
+
+#define POWER_ACTIVE 0
+#define POWER_DIM 1
+#define POWER_OFF 2
+
+typedef void (*power_level_t)(uint8_t level);
+typedef uint8_t (*power_ready_t)(void);
+
+extern uint16_t power_downs;    // times the MCU has powered down
+
+void power_init(uint16_t dim_ms, uint16_t off_ms, power_level_t handler, power_ready_t ready);
+void power_activity(void);
+uint8_t power_level(void);
+void power_sleep(void);
+
+#endif /* POWER_H_ */
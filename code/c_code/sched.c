@@ -0,0 +1,96 @@
+/*
+Cooperative task scheduler on the timebase
+*/
+#include <avr/io.h>
+#include <avr/sleep.h>
+#include "sched.h"
+#include "timebase.h"
+
+#define SCHED_FREE 0
+#define SCHED_PERIODIC 1
+#define SCHED_ONESHOT 2
+
+typedef struct {
+    sched_task_t task;
+    uint8_t kind;
+    uint16_t period;    // ms, 0 = every pass
+    uint32_t due;       // timebase_ms() of the next run
+} sched_slot_t;
+
+static sched_slot_t slots[SCHED_MAX_TASKS];
+static sched_task_t sleep = 0;  // end of pass, 0 = idle mode
+
+uint8_t sched_late = 0;
+
+void sched_init(void)
+{
+    for (uint8_t i = 0; i < SCHED_MAX_TASKS; i++)
+        slots[i].kind = SCHED_FREE;
+    set_sleep_mode(SLEEP_MODE_IDLE);
+}
+
+static uint8_t add(sched_task_t task, uint8_t kind, uint16_t ms)
+{
+    for (uint8_t i = 0; i < SCHED_MAX_TASKS; i++) {
+        if (slots[i].kind == SCHED_FREE) {
+            slots[i].task = task;
+            slots[i].period = ms;
+            slots[i].due = timebase_ms() + ms;
+            slots[i].kind = kind;
+            return i;
+        }
+    }
+    return SCHED_NONE;
+}
+
+// runs task every period_ms (0 = on every pass), first run one period from now
+uint8_t sched_every(sched_task_t task, uint16_t period_ms)
+{
+    return add(task, SCHED_PERIODIC, period_ms);
+}
+
+// runs task once, delay_ms from now; the id is free again once it has run
+uint8_t sched_after(sched_task_t task, uint16_t delay_ms)
+{
+    return add(task, SCHED_ONESHOT, delay_ms);
+}
+
+void sched_cancel(uint8_t id)
+{
+    if (id < SCHED_MAX_TASKS)
+        slots[id].kind = SCHED_FREE;
+}
+
+void sched_run(void)
+{
+    for (uint8_t i = 0; i < SCHED_MAX_TASKS; i++) {
+        sched_slot_t *slot = &slots[i];
+        uint32_t now = timebase_ms();
+
+        if (slot->kind == SCHED_FREE || (int32_t)(now - slot->due) < 0)
+            continue;
+
+        if (slot->kind == SCHED_ONESHOT) {
+            slot->kind = SCHED_FREE;    // before the call, so the task can schedule itself again
+        } else {
+            slot->due += slot->period;
+            // fell a whole period behind: skip the missed runs rather than bunching them up
+            if (slot->period && (int32_t)(now - slot->due) >= (int32_t)slot->period) {
+                slot->due = now + slot->period;
+                sched_late++;
+            }
+        }
+        slot->task();
+    }
+
+    if (sleep)
+        sleep();
+    else
+        sleep_mode();   // woken by the 1 ms timebase tick or any other interrupt
+}
+
+// sleep at the end of every pass, must return once an interrupt has woken the MCU
+void sched_set_sleep(sched_task_t fn)
+{
+    sleep = fn;
+}
@@ -0,0 +1,33 @@
+/*
+Header file for the cooperative task scheduler
+
+Runs short non-blocking functions off the 1 ms timebase: periodic tasks (sched_every()), one-shot timers
+(sched_after()) in place of blocking delays, and idle tasks (period 0) run on every pass. sched_run() runs
+whatever is due and then sleeps in idle mode until the next interrupt, so the main loop is just
+
+    while (1) sched_run();
+
+Tasks must return quickly: a task that blocks delays every other one. Call timebase_init() first.
+sched_set_sleep() replaces the idle-mode sleep at the end of each pass, e.g. with power_sleep() (power.h).
+*/
+
+#ifndef SCHED_H_
+#define SCHED_H_
+
+#include <stdint.h>
+
+#define SCHED_MAX_TASKS 8
+#define SCHED_NONE 0xFF         // no task, returned when every slot is taken
+
+typedef void (*sched_task_t)(void);
+
+extern uint8_t sched_late;      // periodic runs skipped because a pass took longer than the period
+
+void sched_init(void);
+uint8_t sched_every(sched_task_t task, uint16_t period_ms);
+uint8_t sched_after(sched_task_t task, uint16_t delay_ms);
+void sched_cancel(uint8_t id);
+void sched_run(void);
+void sched_set_sleep(sched_task_t sleep);
+
+#endif /* SCHED_H_ */
@@ -0,0 +1,113 @@
+/*
+Latch servo on Timer4 hardware PWM (OC4B)
+*/
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include "servo.h"
+
+#define SERVO_PRESCALER 8
+#define SERVO_COUNTS_PER_US (F_CPU / SERVO_PRESCALER / 1000000UL)      // 2 -> 0.5 us resolution
+#define SERVO_TOP (SERVO_FRAME_US * SERVO_COUNTS_PER_US - 1)            // 39999
+
+// pulse the ramp is heading for and how far it moves per frame, in timer counts
+static volatile uint16_t target;
+static volatile uint16_t step;
+static volatile uint16_t pulse;     // OCR4B as last written
+
+static uint16_t us_to_counts(uint16_t us)
+{
+    // constrain pulse to 1000-2000 us (based on servo data sheet)
+    // this gives about 90 deg ROM, I found that using 500 and 2500 instead gives more ROM
+    if (us < SERVO_MIN_US) us = SERVO_MIN_US;
+    if (us > SERVO_MAX_US) us = SERVO_MAX_US;
+    return us * SERVO_COUNTS_PER_US;
+}
+
+// function to map angle in degrees to pulse length in us
+static uint16_t deg_to_us(uint8_t angle)
+{
+    if (angle > 180) angle = 180;
+    return 600 + ((uint32_t)angle * 1800UL) / 180;
+}
+
+void servo_init(void)
+{
+    // PD2 as output
+    DDRD |= (1 << SERVO_PIN);
+
+    // Timer4 fast PWM (mode 14, TOP = ICR4), OC4B cleared on compare, set at BOTTOM
+    pulse = target = us_to_counts(1500);
+    ICR4 = SERVO_TOP;
+    OCR4B = pulse;
+    TCCR4A = (1 << COM4B1) | (1 << WGM41);
+    TCCR4B = (1 << WGM43) | (1 << WGM42) | (1 << CS41);    // prescaler = 8
+    sei();
+}
+
+// one ramp step per frame; OCR4B is double-buffered, so the new pulse starts cleanly with the next frame
+ISR(TIMER4_OVF_vect)
+{
+    uint16_t now = pulse;
+
+    if (now < target)
+        now = (target - now > step) ? now + step : target;
+    else
+        now = (now - target > step) ? now - step : target;
+
+    pulse = now;
+    OCR4B = now;
+    if (now == target)
+        TIMSK4 &= ~(1 << TOIE4);
+}
+
+// jumps straight to the pulse, from the next frame
+void servo_set_us(uint16_t us)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        TIMSK4 &= ~(1 << TOIE4);
+        pulse = target = us_to_counts(us);
+        OCR4B = pulse;
+    }
+}
+
+// ramps to the pulse over about ms
+void servo_move_us(uint16_t us, uint16_t ms)
+{
+    uint16_t frames = ms / (SERVO_FRAME_US / 1000);
+
+    if (frames == 0) {
+        servo_set_us(us);
+        return;
+    }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        target = us_to_counts(us);
+        uint16_t distance = (target > pulse) ? target - pulse : pulse - target;
+        step = (distance + frames - 1) / frames;
+        if (step == 0)
+            step = 1;
+        TIFR4 = (1 << TOV4);
+        TIMSK4 |= (1 << TOIE4);
+    }
+}
+
+void servo_write_deg(uint8_t angle)
+{
+    servo_set_us(deg_to_us(angle));
+}
+
+void servo_move_deg(uint8_t angle, uint16_t ms)
+{
+    servo_move_us(deg_to_us(angle), ms);
+}
+
+// still ramping
+uint8_t servo_busy(void)
+{
+    return (TIMSK4 & (1 << TOIE4)) != 0;
+}
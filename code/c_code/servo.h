@@ -0,0 +1,29 @@
+/*
+Header file for the latch servo on the LCD MCU
+
+The pulse comes straight from Timer4's hardware PWM on OC4B (PD2, the servo pin): fast PWM with ICR4 as TOP
+gives a 20 ms frame in 0.5 us steps, so holding a position costs no CPU at all. Timer1 would be the usual
+choice but its OC1A/OC1B pins are the LCD's RST and CS, and Timer3 is the timebase.
+
+servo_move_deg() ramps to the new angle instead of jumping: the Timer4 overflow interrupt moves the pulse one
+step per frame (50 times a second) and turns itself off when the target is reached.
+*/
+
+#ifndef SERVO_H_
+#define SERVO_H_
+
+#include <stdint.h>
+
+#define SERVO_PIN PD2
+#define SERVO_FRAME_US 20000UL
+#define SERVO_MIN_US 1000           // pulse limits from the servo data sheet (about 90 degrees of travel)
+#define SERVO_MAX_US 2000
+
+void servo_init(void);
+void servo_set_us(uint16_t us);
+void servo_move_us(uint16_t us, uint16_t ms);
+void servo_write_deg(uint8_t angle);
+void servo_move_deg(uint8_t angle, uint16_t ms);
+uint8_t servo_busy(void);
+
+#endif /* SERVO_H_ */
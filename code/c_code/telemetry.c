@@ -0,0 +1,87 @@
+/*
+Binary telemetry records, COBS framed over the uart.c TX ring
+*/
+#include <util/crc16.h>
+#include "telemetry.h"
+#include "timebase.h"
+#include "uart.h"
+
+#if TELEMETRY_ENABLE
+
+#define TELEM_HEADER 6      // type, seq, time
+#define TELEM_MAX_PAYLOAD 7
+
+static uint8_t seq = 0;
+
+// COBS: every 0x00 becomes the distance to the next one, so the only 0x00 on the wire ends the frame
+// (records are far shorter than the 254-byte block limit, so no block ever needs splitting)
+static void send_frame(const uint8_t *data, uint8_t length)
+{
+    uint8_t start = 0;
+
+    while (start <= length) {
+        uint8_t end = start;
+        while (end < length && data[end] != 0)
+            end++;
+        uart_send(end - start + 1, 0);
+        for (uint8_t i = start; i < end; i++)
+            uart_send(data[i], 0);
+        start = end + 1;
+    }
+    uart_send(0, 0);
+}
+
+static void send_record(uint8_t type, const uint8_t *payload, uint8_t length)
+{
+    uint8_t record[TELEM_HEADER + TELEM_MAX_PAYLOAD + 2];
+    uint32_t now = timebase_ms();
+    uint16_t crc = 0;
+    uint8_t n = 0;
+
+    record[n++] = type;
+    record[n++] = seq++;
+    record[n++] = now;
+    record[n++] = now >> 8;
+    record[n++] = now >> 16;
+    record[n++] = now >> 24;
+    for (uint8_t i = 0; i < length; i++)
+        record[n++] = payload[i];
+    for (uint8_t i = 0; i < n; i++)
+        crc = _crc_xmodem_update(crc, record[i]);
+    record[n++] = crc;
+    record[n++] = crc >> 8;
+
+    send_frame(record, n);
+}
+
+void telemetry_adc(uint16_t adc0, uint16_t adc1, uint16_t adc2, uint8_t switches)
+{
+    uint8_t payload[] = {adc0, adc0 >> 8, adc1, adc1 >> 8, adc2, adc2 >> 8, switches};
+    send_record(TELEM_ADC, payload, sizeof(payload));
+}
+
+void telemetry_key(uint8_t key, uint8_t digits)
+{
+    uint8_t payload[] = {key, digits};
+    send_record(TELEM_KEY, payload, sizeof(payload));
+}
+
+void telemetry_state(uint8_t from, uint8_t event, uint8_t to, uint8_t arg)
+{
+    uint8_t payload[] = {from, event, to, arg};
+    send_record(TELEM_STATE, payload, sizeof(payload));
+}
+
+void telemetry_link(uint8_t type, uint8_t arg)
+{
+    uint8_t payload[] = {type, arg};
+    send_record(TELEM_LINK, payload, sizeof(payload));
+}
+
+void telemetry_zone(uint8_t knob, uint8_t entered, uint16_t dwell_ms)
+{
+    uint8_t payload[] = {knob, entered, dwell_ms, dwell_ms >> 8};
+    send_record(TELEM_ZONE, payload, sizeof(payload));
+}
+
+#endif /* TELEMETRY_ENABLE */
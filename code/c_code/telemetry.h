@@ -0,0 +1,48 @@
+/*
+Header file for the binary telemetry stream on the keypad MCU
+
+Replaces the printf status lines. Each record is a fixed little-endian layout:
+
+    | type | seq | time ms (4) | payload | CRC-16 (2) |
+
+CRC-16/XMODEM (_crc_xmodem_update, init 0) covers type..payload. The record is COBS encoded and ends in a 0x00,
+so it can share USART0 TX with text (console replies, trace dumps): text never contains 0x00, and the decoder
+(host_code/telemetry_decode.cpp) passes anything that isn't a valid frame through as text. seq counts every
+record, so gaps show what the TX ring dropped.
+
+Build with -DTELEMETRY_ENABLE=0 to compile every record out.
+*/
+
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include <stdint.h>
+
+#ifndef TELEMETRY_ENABLE
+#define TELEMETRY_ENABLE 1
+#endif
+
+// record types and payloads, keep telemetry_decode.cpp in step
+#define TELEM_ADC 1         // adc0, adc1, adc2 (u16 each), switches (u8, bit0-2 SW0-2)
+#define TELEM_KEY 2         // key (u8, TELEM_KEY_DIGIT for any PIN digit), PIN digits entered (u8)
+#define TELEM_STATE 3       // from, event, to, arg (u8 each, vault_fsm.h values)
+#define TELEM_LINK 4        // message sent to the LCD MCU: type, arg (u8 each, mcu_link.h values)
+#define TELEM_ZONE 5        // knob (u8), entered 1 / left 0 (u8), ms spent in the other state (u16)
+
+#define TELEM_KEY_DIGIT 0xFF    // digits are not logged, only that one was pressed
+
+#if TELEMETRY_ENABLE
+void telemetry_adc(uint16_t adc0, uint16_t adc1, uint16_t adc2, uint8_t switches);
+void telemetry_key(uint8_t key, uint8_t digits);
+void telemetry_state(uint8_t from, uint8_t event, uint8_t to, uint8_t arg);
+void telemetry_link(uint8_t type, uint8_t arg);
+void telemetry_zone(uint8_t knob, uint8_t entered, uint16_t dwell_ms);
+#else
+#define telemetry_adc(adc0, adc1, adc2, switches)
+#define telemetry_key(key, digits)
+#define telemetry_state(from, event, to, arg)
+#define telemetry_link(type, arg)
+#define telemetry_zone(knob, entered, dwell_ms)
+#endif
+
+#endif /* TELEMETRY_H_ */
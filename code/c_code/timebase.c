@@ -0,0 +1,56 @@
+/*
+Shared system timebase on Timer3
+*/
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include "timebase.h"
+
+static volatile uint32_t timebase_millis = 0;
+
+void timebase_init(void)
+{
+    TCCR3A = 0;
+    TCCR3B = (1 << WGM32) | (1 << CS31) | (1 << CS30);   // CTC on OCR3A, /64 prescaler
+    OCR3A = TIMEBASE_TOP;
+    TCNT3 = 0;
+    TIMSK3 = (1 << OCIE3A);
+
+    sei();
+}
+
+ISR(TIMER3_COMPA_vect)
+{
+    timebase_millis++;
+}
+
+// milliseconds since timebase_init()
+uint32_t timebase_ms(void)
+{
+    uint32_t ms;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        ms = timebase_millis;
+    }
+    return ms;
+}
+
+// microseconds since timebase_init() (4 us resolution), safe to call from ISRs
+uint32_t timebase_us(void)
+{
+    uint32_t ms;
+    uint16_t count;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        ms = timebase_millis;
+        count = TCNT3;
+        // the counter wrapped but the compare ISR hasn't run yet
+        if ((TIFR3 & (1 << OCF3A)) && count < TIMEBASE_TOP / 2)
+            ms++;
+    }
+    return ms * 1000UL + (uint32_t)count * TIMEBASE_US_PER_COUNT;
+}
@@ -0,0 +1,22 @@
+/*
+Header file for the shared system timebase
+
+Timer3 (16-bit, only on the 328PB) runs in CTC mode and interrupts once per millisecond. Both MCUs use it
+for timestamps and timeouts, so Timer0/1/2 stay free for PWM. The output compare pins are not connected.
+*/
+
+#ifndef TIMEBASE_H_
+#define TIMEBASE_H_
+
+#include <avr/io.h>
+#include <stdint.h>
+
+#define TIMEBASE_PRESCALER 64                              // 4 us per count at 16 MHz
+#define TIMEBASE_US_PER_COUNT (TIMEBASE_PRESCALER / (F_CPU / 1000000UL))
+#define TIMEBASE_TOP ((F_CPU / TIMEBASE_PRESCALER / 1000UL) - 1)   // 249 -> 1 ms
+
+void timebase_init(void);
+uint32_t timebase_ms(void);
+uint32_t timebase_us(void);
+
+#endif /* TIMEBASE_H_ */
@@ -0,0 +1,196 @@
+/*
+Unlock-sequence trace ring, dumped over USART0 TX a line per scheduler pass
+*/
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include <stdlib.h>
+#include "trace.h"
+#include "timebase.h"
+#include "sched.h"
+
+#if TRACE_ENABLE
+
+// no writer given: straight to UDR0, but only when it is free
+static uint8_t put_udr(char c)
+{
+    if (!(UCSR0A & (1 << UDRE0)))
+        return 0;
+    UDR0 = c;
+    return 1;
+}
+
+typedef struct {
+    uint32_t time_us;
+    uint8_t event;
+    uint8_t arg;
+} trace_event_t;
+
+static trace_event_t ring[TRACE_SIZE];
+static uint8_t ring_head = 0;       // next slot to write
+static uint8_t ring_count = 0;
+static uint8_t ring_lost = 0;
+static const char *name = "avr";
+static trace_put_t put = put_udr;
+
+// dump in progress
+static uint8_t dumping = 0;
+static uint8_t dump_tail;               // next event to send
+static volatile uint8_t dump_left = 0;  // events still to send, trace_mark() leaves their slots alone
+static uint8_t dump_lost;
+static uint32_t dump_time;
+static char line[48];                   // line being written
+static uint8_t line_length = 0;
+static uint8_t line_sent = 0;
+
+void trace_init(const char *mcu_name, trace_put_t writer)
+{
+    name = mcu_name;
+    put = writer ? writer : put_udr;
+}
+
+// records an event, overwriting the oldest one when full (but never one a dump has yet to send); safe to call
+// from ISRs
+void trace_mark(uint8_t event, uint8_t arg)
+{
+    uint32_t now = timebase_us();
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (dump_left && ring_count + dump_left >= TRACE_SIZE) {
+            if (ring_lost < 0xFF)
+                ring_lost++;
+            return;
+        }
+        ring[ring_head].time_us = now;
+        ring[ring_head].event = event;
+        ring[ring_head].arg = arg;
+        ring_head = (ring_head + 1) & (TRACE_SIZE - 1);
+        if (ring_count < TRACE_SIZE)
+            ring_count++;
+        else if (ring_lost < 0xFF)
+            ring_lost++;
+    }
+}
+
+// keypad MCU: record TRACE_SYNC on every rising edge of TRACE_SYNC_PIN
+void trace_sync_listen(void)
+{
+    DDRC &= ~(1 << TRACE_SYNC_PIN);
+    PORTC &= ~(1 << TRACE_SYNC_PIN);
+    PCMSK1 |= (1 << PCINT11);
+    PCICR |= (1 << PCIE1);
+    sei();
+}
+
+ISR(PCINT1_vect)
+{
+    if (PINC & (1 << TRACE_SYNC_PIN))
+        trace_mark(TRACE_SYNC, 0);
+}
+
+static uint8_t append(uint8_t n, const char *s)
+{
+    while (*s && n < sizeof(line) - 1)
+        line[n++] = *s++;
+    return n;
+}
+
+static uint8_t append_number(uint8_t n, uint32_t value)
+{
+    char digits[11];
+    return append(n, ultoa(value, digits, 10));
+}
+
+static void format_event(uint32_t time_us, uint8_t event, uint8_t arg)
+{
+    uint8_t n = append(0, "TRACE,");
+    n = append(n, name);
+    n = append(n, ",");
+    n = append_number(n, time_us);
+    n = append(n, ",");
+    n = append_number(n, event);
+    n = append(n, ",");
+    n = append_number(n, arg);
+    n = append(n, "\r\n");
+    line_length = n;
+    line_sent = 0;
+}
+
+// one scheduler pass of a dump: finishes the current line and formats at most one more, then comes back on the
+// next pass for whatever the writer couldn't take
+static void dump_task(void)
+{
+    uint8_t formatted = 0;
+
+    while (1) {
+        while (line_sent < line_length) {
+            if (!put(line[line_sent]))
+                goto next_pass;
+            line_sent++;
+        }
+        if (formatted)
+            break;
+        formatted = 1;
+
+        if (dump_lost) {
+            format_event(dump_time, TRACE_OVERFLOW, dump_lost);
+            dump_lost = 0;
+        } else if (dump_left) {
+            trace_event_t *event = &ring[dump_tail];
+            format_event(event->time_us, event->event, event->arg);
+            dump_tail = (dump_tail + 1) & (TRACE_SIZE - 1);
+            ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+                dump_left--;    // the slot is free for trace_mark() again
+            }
+        } else {
+            dumping = 0;
+            return;
+        }
+    }
+
+next_pass:
+    if (sched_after(dump_task, 0) == SCHED_NONE)
+        dumping = 0;    // no free slot: give up, the rest goes with the next dump
+}
+
+/*
+Starts writing every recorded event (oldest first) and empties the ring, without waiting: dump_task() sends a
+line or so per scheduler pass. The events being sent stay frozen in the ring until each is formatted; events
+recorded meanwhile go in behind them, and once they would overwrite an unsent one they are counted as lost
+instead. Does nothing while a dump is still going, the new events stay for the next one.
+*/
+void trace_dump(void)
+{
+    if (dumping)
+        return;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        dump_left = ring_count;
+        dump_tail = (ring_head - ring_count) & (TRACE_SIZE - 1);
+        dump_lost = ring_lost;
+        ring_count = 0;
+        ring_lost = 0;
+    }
+    if (!dump_left && !dump_lost)
+        return;
+
+    dump_time = timebase_us();
+    line_length = 0;
+    line_sent = 0;
+    if (put == put_udr)
+        UCSR0B |= (1 << TXEN0);     // vault_link_init() only turns the receiver on
+    if (sched_after(dump_task, 0) != SCHED_NONE)
+        dumping = 1;
+}
+
+// a dump is still being written
+uint8_t trace_busy(void)
+{
+    return dumping;
+}
+
+#endif /* TRACE_ENABLE */
@@ -0,0 +1,67 @@
+/*
+Header file for unlock-sequence tracing
+
+Each MCU records timestamped events (timebase_us()) into a RAM ring and dumps it over USART0 TX once per
+unlock cycle. All three clocks are aligned on sync pulses: the LCD MCU raises FINGER_OUT (PC0 -> ESP32 GPIO7)
+and TRACE_SYNC_PIN (PC3 -> keypad MCU PC3, the old state bus wire) with one port write, and every MCU records
+TRACE_SYNC at the edge. host_code/trace_merge.cpp turns the dumps into one Chrome trace.
+
+Dump lines: TRACE,<mcu>,<time us>,<event>,<arg>
+trace_dump() never waits on the UART: a scheduler task hands the lines to the writer given to trace_init() a bit
+per pass (uart_try_send() on the keypad MCU, which shares the uart.c TX ring with printf() and telemetry; 0 on the
+LCD MCU, where the dump goes straight to UDR0 whenever it is free). USART0 must already be configured (uart_init()
+on the keypad MCU, vault_link_init() on the LCD MCU at 250 kbaud), and sched_init() must have run before the
+first dump. A full dump of TRACE_SIZE events is about 1 kB, ~170 ms at 57600 baud.
+
+Build with -DTRACE_ENABLE=0 to compile every trace call out.
+*/
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <avr/io.h>
+#include <stdint.h>
+
+#ifndef TRACE_ENABLE
+#define TRACE_ENABLE 1
+#endif
+
+#define TRACE_SIZE 32               // events kept, power of 2 (6 bytes each)
+#define TRACE_SYNC_PIN PC3
+
+// event IDs, shared with VaultTrace.h on the ESP32 and the name table in trace_merge.cpp
+#define TRACE_SYNC 0x00             // sync pulse edge, arg = pulse count on the LCD MCU
+#define TRACE_OVERFLOW 0x01         // arg = events lost since the last dump
+// LCD MCU
+#define TRACE_LCD_IDENTITY 0x20     // identity frame accepted, arg = identity code
+#define TRACE_LCD_DOOR_OPEN 0x21    // sliding door open
+#define TRACE_LCD_MSG 0x22          // message from the keypad MCU, arg = type
+#define TRACE_LCD_SCREEN 0x23       // stage screen drawn and acknowledged, arg = stage
+#define TRACE_LCD_LATCH_OPEN 0x24
+#define TRACE_LCD_LOCK 0x25         // lock command received
+#define TRACE_LCD_LOCKED 0x26       // box closed, lock acknowledged
+// keypad MCU
+#define TRACE_KEYPAD_IDENTITY 0x30  // identity message received, arg = identity code
+#define TRACE_KEYPAD_ACK 0x31       // LCD MCU acknowledged, arg = message type
+#define TRACE_KEYPAD_COMBINATION 0x32
+#define TRACE_KEYPAD_DIGIT 0x33     // arg = digits entered
+#define TRACE_KEYPAD_PIN 0x34       // arg = 1 correct, 0 wrong
+#define TRACE_KEYPAD_LOCK 0x35      // lock key pressed
+
+typedef uint8_t (*trace_put_t)(char c);   // 0 if c can't be taken yet
+
+#if TRACE_ENABLE
+void trace_init(const char *mcu_name, trace_put_t writer);
+void trace_mark(uint8_t event, uint8_t arg);
+void trace_sync_listen(void);
+void trace_dump(void);
+uint8_t trace_busy(void);
+#else
+#define trace_init(mcu_name, writer)
+#define trace_mark(event, arg)
+#define trace_sync_listen()
+#define trace_dump()
+#define trace_busy() 0
+#endif
+
+#endif /* TRACE_H_ */
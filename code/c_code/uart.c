@@ -1,54 +1,323 @@
 #include <stdio.h>
 #include "uart.h"
-#include <avr/io.h>
+#include "hal.h"
 #include <stdarg.h>
 #include <string.h>
 #define F_CPU 16000000UL 
 
+// the ring needs the UDRE interrupt, host builds (HAL_HOST) write straight through
+#if UART_TX_BUFFER_SIZE && !defined(HAL_HOST)
+#define UART_TX_RING
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+#define UART_TX_MASK (UART_TX_BUFFER_SIZE - 1)
+
+static char tx_buffer[UART_TX_BUFFER_SIZE];
+static volatile uint8_t tx_head = 0;    // next free slot, written by uart_send()
+static volatile uint8_t tx_tail = 0;    // next to send, advanced by the ISR
+static volatile uint8_t tx_count = 0;
+#endif
+
+#if UART_RX_BUFFER_SIZE && !defined(HAL_HOST)
+#define UART_RX_RING
+#include <avr/interrupt.h>
+
+#define UART_RX_MASK (UART_RX_BUFFER_SIZE - 1)
+
+static char rx_buffer[UART_RX_BUFFER_SIZE];
+static volatile uint8_t rx_head = 0;    // written by the ISR
+static volatile uint8_t rx_tail = 0;    // read by uart_getc()
+#endif
+
+volatile uint16_t uart_tx_dropped = 0;
+uint8_t uart_tx_peak = 0;
+volatile uint8_t uart_rx_overruns = 0;
+uint8_t uart_line_ending = UART_ENDING_UNKNOWN;
+
+// line being assembled by uart_try_line()
+static char line[MAX_STRING_LENGTH];
+static uint8_t line_length = 0;
+static uint8_t line_ready = 0;      // line[] holds a finished line not yet handed out
+static char last_end = 0;           // terminator that finished the previous line, to spot CRLF
+
 void uart_init()
 {
-    /*Set baud rate */
-    UBRR0H = (unsigned char)(UART_BAUD_PRESCALER>>8);
-    UBRR0L = (unsigned char)UART_BAUD_PRESCALER;
-    //Enable receiver and transmitter
-    UCSR0B = (1<<RXEN0)|(1<<TXEN0);
-    /* Set frame format: 2 stop bits, 8 data bits */
-    UCSR0C = (1<<UCSZ01) | (1<<UCSZ00); // 8 data bits
-    UCSR0C |= (1<<USBS0); // 2 stop bits
+    /* Set baud rate (double speed), enable receiver and transmitter, frame format: 2 stop bits, 8 data bits */
+    hal_uart_init(UART_BAUD_PRESCALER, 1, 1);
     
     __init_stdout(uart_send);
     __init_stdin(uart_receive);
+#ifdef UART_RX_RING
+    UCSR0B |= (1 << RXCIE0);
+#endif
+#if defined(UART_TX_RING) || defined(UART_RX_RING)
+    sei();
+#endif
+}
+
+#ifdef UART_TX_RING
+// UDR0 empty: send the next queued character, or switch the interrupt off once the ring is drained
+ISR(USART0_UDRE_vect)
+{
+    if (tx_count) {
+        UDR0 = tx_buffer[tx_tail];
+        tx_tail = (tx_tail + 1) & UART_TX_MASK;
+        tx_count--;
+    } else {
+        UCSR0B &= ~(1 << UDRIE0);
+    }
 }
 
 int uart_send(char data, FILE* stream)
 {
-    // Wait for empty transmit buffer
-    while(!(UCSR0A & (1<<UDRE0)));
-    // Put data into buffer and send data
-    UDR0 = data;
+#if UART_TX_POLICY == UART_TX_BLOCK
+    while (tx_count == UART_TX_BUFFER_SIZE);    // the ISR makes room
+#endif
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (tx_count == UART_TX_BUFFER_SIZE) {
+#if UART_TX_POLICY == UART_TX_DROP_OLDEST
+            tx_tail = (tx_tail + 1) & UART_TX_MASK;
+            tx_count--;
+            uart_tx_dropped++;
+#else
+            uart_tx_dropped++;
+            return 0;
+#endif
+        }
+        tx_buffer[tx_head] = data;
+        tx_head = (tx_head + 1) & UART_TX_MASK;
+        tx_count++;
+        if (tx_count > uart_tx_peak)
+            uart_tx_peak = tx_count;
+        UCSR0B |= (1 << UDRIE0);    // fires straight away if UDR0 is already empty
+    }
     return 0;
 }
 
+// background output (trace dumps): queues data only while the ring is less than half full, so printf() and
+// telemetry always find room; 0 if it didn't, try again on a later pass
+uint8_t uart_try_send(char data)
+{
+    if (tx_count >= UART_TX_BUFFER_SIZE / 2)
+        return 0;
+    uart_send(data, 0);
+    return 1;
+}
+
+// waits until everything queued has been handed to the UART
+void uart_flush(void)
+{
+    while (tx_count || (UCSR0B & (1 << UDRIE0)));
+    while (!(UCSR0A & (1 << UDRE0)));
+}
+
+// characters not yet handed to the UART, what uart_flush() would wait for (the last one may still be shifting out)
+uint8_t uart_tx_busy(void)
+{
+    return tx_count || (UCSR0B & (1 << UDRIE0)) || !(UCSR0A & (1 << UDRE0));
+}
+#else
+int uart_send(char data, FILE* stream)
+{
+    // Wait for empty transmit buffer, put data into buffer and send data
+    hal_uart_write(data);
+    return 0;
+}
+
+uint8_t uart_try_send(char data)
+{
+#ifndef HAL_HOST
+    if (!(UCSR0A & (1 << UDRE0)))
+        return 0;
+#endif
+    hal_uart_write(data);
+    return 1;
+}
+
+void uart_flush(void)
+{
+}
+
+uint8_t uart_tx_busy(void)
+{
+    return 0;
+}
+#endif
+
+#ifdef UART_RX_RING
+// character received: queue it, counting anything lost to a full ring or an overrun in the UART itself
+ISR(USART0_RX_vect)
+{
+    uint8_t status = UCSR0A;
+    char c = UDR0;
+    uint8_t next = (rx_head + 1) & UART_RX_MASK;
+
+    if (status & (1 << DOR0))
+        uart_rx_overruns++;
+    if (next == rx_tail) {
+        uart_rx_overruns++;
+        return;
+    }
+    rx_buffer[rx_head] = c;
+    rx_head = next;
+}
+
+// next received character, -1 if there is none yet
+int uart_getc(void)
+{
+    uint8_t tail = rx_tail;
+    if (tail == rx_head)
+        return -1;
+    char c = rx_buffer[tail];
+    rx_tail = (tail + 1) & UART_RX_MASK;
+    return (uint8_t)c;
+}
+#else
+int uart_getc(void)
+{
+    return hal_uart_ready() ? hal_uart_read() : -1;
+}
+#endif
+
+// stdin: waits for the next character
 int uart_receive(FILE* stream)
 {
-    while (!(UCSR0A & (1 << RXC0)));
-    return UDR0;
+    int c;
+    while ((c = uart_getc()) < 0);
+    return c;
 }
 
-void determine_line_ending() {
-    char c;
-    printf("Press Enter to detect the line ending style...\n");
-
-    while(1)
-    {
-        c = uart_receive(NULL);
-        if (c == '\r') {
-            printf("\\r (CR) detected.\n");
-        } else if (c == '\n') {
-            printf("\\n (LF) detected.\n");
+/*
+Returns the next complete line (terminator stripped) once one has arrived, NULL until then. CR, LF and CRLF all
+end a line; the LF of a CRLF is swallowed instead of producing an empty line. Backspace/DEL remove the last
+character. Characters past MAX_STRING_LENGTH - 1 are dropped. The line stays valid until the next call.
+*/
+char* uart_try_line(void)
+{
+    int c;
+
+    if (line_ready) {       // the caller has had it, start the next one
+        line_ready = 0;
+        line_length = 0;
+    }
+
+    while ((c = uart_getc()) >= 0) {
+        if (c == '\r' || c == '\n') {
+            if (c == '\n' && last_end == '\r' && line_length == 0) {
+                last_end = 0;
+                uart_line_ending = UART_ENDING_CRLF;
+                continue;
+            }
+            last_end = c;
+            uart_line_ending = (c == '\r') ? UART_ENDING_CR : UART_ENDING_LF;
+            line[line_length] = '\0';
+            line_ready = 1;
+            return line;
+        }
+        last_end = 0;
+        if (c == '\b' || c == 0x7F) {
+            if (line_length)
+                line_length--;
+        } else if (line_length < MAX_STRING_LENGTH - 1) {
+            line[line_length++] = c;
+        }
+    }
+    return NULL;
+}
+
+/*
+Parses the next complete line against format without waiting. Returns -1 if no line has arrived yet, otherwise
+the number of fields converted before the first mismatch (the rest of the line is discarded either way).
+    %d   optional sign and decimal digits, fails on int overflow
+    %Ns  one word of at most N characters (MAX_STRING_LENGTH - 1 if N is left out), destination needs N + 1 bytes
+    %c   one character (whitespace included)
+    ' '  any amount of whitespace, including none
+Any other character must match exactly.
+*/
+int uart_try_scanf(const char* format, ...)
+{
+    const char* in = uart_try_line();
+    if (!in)
+        return -1;
+
+    va_list args;
+    va_start(args, format);
+    int fields = 0;
+
+    for (const char* p = format; *p; p++) {
+        if (*p == ' ') {
+            while (*in == ' ' || *in == '\t')
+                in++;
+            continue;
+        }
+        if (*p != '%') {
+            if (*in++ != *p)
+                break;
+            continue;
+        }
+
+        unsigned width = 0;
+        while (p[1] >= '0' && p[1] <= '9')
+            width = width * 10 + (*++p - '0');
+        p++;
+
+        if (*p == 'd') {
+            while (*in == ' ' || *in == '\t')
+                in++;
+            uint8_t negative = (*in == '-');
+            if (*in == '-' || *in == '+')
+                in++;
+            if (*in < '0' || *in > '9')
+                break;
+            long num = 0;
+            while (*in >= '0' && *in <= '9' && num <= 32768)
+                num = num * 10 + (*in++ - '0');
+            if (negative)
+                num = -num;
+            if (num > 32767 || num < -32768 || (*in >= '0' && *in <= '9'))
+                break;
+            *va_arg(args, int*) = (int)num;
+        } else if (*p == 's') {
+            if (width == 0 || width > MAX_STRING_LENGTH - 1)
+                width = MAX_STRING_LENGTH - 1;
+            while (*in == ' ' || *in == '\t')
+                in++;
+            if (!*in)
+                break;
+            char* out = va_arg(args, char*);
+            unsigned n = 0;
+            while (*in && *in != ' ' && *in != '\t') {
+                if (n < width)
+                    out[n++] = *in;
+                in++;
+            }
+            out[n] = '\0';
+        } else if (*p == 'c') {
+            if (!*in)
+                break;
+            *va_arg(args, char*) = *in++;
         } else {
-            printf("Unknown line ending.\n");
+            break;      // unsupported conversion
         }
+        fields++;
+    }
+
+    va_end(args);
+    return fields;
+}
+
+// reports the line ending of the last line received, without waiting for one
+void determine_line_ending() {
+    if (uart_line_ending == UART_ENDING_UNKNOWN) {
+        printf("Press Enter to detect the line ending style...\n");
+    } else if (uart_line_ending == UART_ENDING_CR) {
+        printf("\\r (CR) detected.\n");
+    } else if (uart_line_ending == UART_ENDING_LF) {
+        printf("\\n (LF) detected.\n");
+    } else {
+        printf("\\r\\n (CRLF) detected.\n");
     }
 }
 
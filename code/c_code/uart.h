@@ -3,6 +3,7 @@
 #define F_CPU 16000000UL 
 
 #include <stdio.h>
+#include <stdint.h>
 
 /***************************************/
 /* USER CONFIG */
@@ -18,6 +19,7 @@
  * VSCode serial monitor extension supports all three.
  * 
  * Call determine_line_ending() in your code to see which one your terminal supports.
+ * Only uart_scanf() needs this; uart_try_line() and uart_try_scanf() work it out per line.
  */
 #define CRLF
 
@@ -28,13 +30,39 @@
 
 /**
  * Set UART baud rate
- * This has been tested to work fine with 9600
- * 
- * If using other baud rates, slight adjustments may need to be made
- * to the UART_BAUD_PRESCALER macro (add or subtract a few counts)
- * due to baud rate error
+ * The prescaler is rounded to the nearest count in double speed (U2X0) mode,
+ * so 9600 through 115200 all come out within 2.1% at 16MHz.
+ * A rate that can't be reached within 2% gives a compile warning.
+ * 57600 (-0.8%) leaves room for the ~1.7kB/s of telemetry.h records.
+ */
+#define UART_BAUD_RATE      57600
+
+/**
+ * Transmit ring buffer
+ * printf() returns as soon as its characters are queued; the UDRE interrupt
+ * sends them in the background. Size is a power of 2 up to 128 (the count
+ * is 8-bit, so 256 would wrap to 0 when full), or 0 to
+ * wait on the UART for every character as before.
+ *
+ * What happens when the buffer is full:
+ *      UART_TX_BLOCK       :   wait for room (debug output can stall the caller)
+ *      UART_TX_DROP_NEWEST :   drop the new character, what's queued stays intact
+ *      UART_TX_DROP_OLDEST :   drop the oldest queued character, the latest output wins
  */
-#define UART_BAUD_RATE      9600
+#define UART_TX_BUFFER_SIZE 128
+#define UART_TX_POLICY      UART_TX_DROP_NEWEST
+
+/**
+ * Receive ring buffer
+ * The RX interrupt queues incoming characters so nothing is lost while the
+ * firmware is busy. Size is a power of 2 up to 256, or 0 to read the UART
+ * directly. uart_try_line() and uart_try_scanf() never wait: they assemble
+ * lines from whatever has arrived and accept CR, LF or CRLF endings.
+ *
+ * Don't link uart.c into the LCD firmware with the ring on: vault_link.c
+ * owns USART0 RX (and its interrupt) there.
+ */
+#define UART_RX_BUFFER_SIZE 64
 
 /***************************************/
 /* MACROS AND FUNCTION DECLARATIONS */
@@ -45,7 +73,44 @@
     #define F_CPU 16000000UL
 #endif
 
-#define UART_BAUD_PRESCALER (((F_CPU / (UART_BAUD_RATE * 16UL))) - 1)
+#define UART_TX_BLOCK       0
+#define UART_TX_DROP_NEWEST 1
+#define UART_TX_DROP_OLDEST 2
+
+// double speed: baud = F_CPU / (8 * (UBRR + 1)), rounded to the nearest UBRR
+#define UART_BAUD_PRESCALER ((F_CPU + 4UL * UART_BAUD_RATE) / (8UL * UART_BAUD_RATE) - 1)
+#define UART_BAUD_ACTUAL    (F_CPU / (8UL * (UART_BAUD_PRESCALER + 1)))
+#define UART_BAUD_ERROR_PERMILLE \
+    ((UART_BAUD_ACTUAL > UART_BAUD_RATE ? UART_BAUD_ACTUAL - UART_BAUD_RATE : UART_BAUD_RATE - UART_BAUD_ACTUAL) \
+     * 1000UL / UART_BAUD_RATE)
+
+#if UART_BAUD_PRESCALER > 4095
+    #error "UART_BAUD_RATE too low for F_CPU"
+#endif
+#if UART_BAUD_ERROR_PERMILLE > 20
+    #warning "UART_BAUD_RATE is more than 2% off at this F_CPU"
+#endif
+#if UART_TX_BUFFER_SIZE & (UART_TX_BUFFER_SIZE - 1) || UART_TX_BUFFER_SIZE > 128
+    #error "UART_TX_BUFFER_SIZE must be 0 or a power of 2 up to 128"
+#endif
+#if UART_RX_BUFFER_SIZE & (UART_RX_BUFFER_SIZE - 1) || UART_RX_BUFFER_SIZE > 256
+    #error "UART_RX_BUFFER_SIZE must be 0 or a power of 2 up to 256"
+#endif
+
+// line endings seen by the line assembler (uart_line_ending)
+#define UART_ENDING_UNKNOWN 0
+#define UART_ENDING_CR      1
+#define UART_ENDING_LF      2
+#define UART_ENDING_CRLF    3
+
+extern volatile uint16_t uart_tx_dropped;   // characters lost to a full buffer
+extern uint8_t uart_tx_peak;                // most characters ever queued at once
+extern volatile uint8_t uart_rx_overruns;   // characters lost to a full ring or a hardware overrun
+extern uint8_t uart_line_ending;            // UART_ENDING_*, from the last line received
+
+// stdio hooks uart_init() installs, provided by the toolchain's stdio (host checks define them as no-ops)
+void __init_stdout(int (*put)(char, FILE*));
+void __init_stdin(int (*get)(FILE*));
 
 void uart_init(void);
 
@@ -53,8 +118,20 @@ int uart_send(char data, FILE* stream);
 
 int uart_receive(FILE* stream);
 
+uint8_t uart_try_send(char data);
+
+void uart_flush(void);
+
+uint8_t uart_tx_busy(void);
+
 void uart_scanf(const char* format, ...);
 
+int uart_getc(void);
+
+char* uart_try_line(void);
+
+int uart_try_scanf(const char* format, ...);
+
 void determine_line_ending(void);
 
 #endif // UART_H
\ No newline at end of file
@@ -0,0 +1,77 @@
+/*
+Vault state machine shared by both ATmega firmwares
+*/
+#include "hal.h"
+#include "vault_fsm.h"
+
+// every legal transition; anything not listed is ignored
+static const vault_transition_t transitions[] PROGMEM = {
+    // from                event                       to                  action
+    {VAULT_LOCKED,      VAULT_EV_IDENTITY,          VAULT_COMBINATION,  VAULT_ACT_START},
+    {VAULT_COMBINATION, VAULT_EV_COMBINATION_OK,    VAULT_PIN,          VAULT_ACT_PIN},
+    {VAULT_PIN,         VAULT_EV_COMBINATION_LOST,  VAULT_COMBINATION,  VAULT_ACT_COMBINATION},
+    {VAULT_PIN,         VAULT_EV_PIN_OK,            VAULT_UNLOCKED,     VAULT_ACT_UNLOCK},
+    {VAULT_PIN,         VAULT_EV_PIN_WRONG,         VAULT_WRONG_PIN,    VAULT_ACT_WRONG_PIN},
+    {VAULT_WRONG_PIN,   VAULT_EV_COMBINATION_LOST,  VAULT_COMBINATION,  VAULT_ACT_COMBINATION},
+    {VAULT_WRONG_PIN,   VAULT_EV_TIMEOUT,           VAULT_PIN,          VAULT_ACT_RETRY},
+    {VAULT_UNLOCKED,    VAULT_EV_LOCK,              VAULT_LOCKED,       VAULT_ACT_LOCK},
+};
+
+#define TRANSITION_COUNT (sizeof(transitions) / sizeof(transitions[0]))
+
+// VAULT_EV_TIMEOUT fires this long after entering the state, 0 = never
+static const uint16_t state_timeout_ms[VAULT_STATE_COUNT] PROGMEM = {
+    [VAULT_WRONG_PIN] = 5000,   // how long "Incorrect PIN" stays up
+};
+
+void vault_fsm_init(vault_fsm_t *fsm, const vault_action_t *actions, uint32_t now_ms)
+{
+    fsm->state = VAULT_LOCKED;
+    fsm->entered_ms = now_ms;
+    fsm->actions = actions;
+}
+
+// moves to row i's state and runs its action
+static void take(vault_fsm_t *fsm, uint8_t i, uint8_t arg, uint32_t now_ms)
+{
+    uint8_t action = pgm_read_byte(&transitions[i].action);
+
+    fsm->state = pgm_read_byte(&transitions[i].to);
+    fsm->entered_ms = now_ms;
+    if (fsm->actions[action])
+        fsm->actions[action](arg);
+}
+
+// owner side: returns 1 if event caused a transition, 0 if the current state ignores it
+uint8_t vault_fsm_dispatch(vault_fsm_t *fsm, uint8_t event, uint8_t arg, uint32_t now_ms)
+{
+    for (uint8_t i = 0; i < TRANSITION_COUNT; i++) {
+        if (pgm_read_byte(&transitions[i].from) == fsm->state && pgm_read_byte(&transitions[i].event) == event) {
+            take(fsm, i, arg, now_ms);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// follower side: takes the transition from the current state to the one the owner reported, 0 if there is none
+uint8_t vault_fsm_follow(vault_fsm_t *fsm, uint8_t to, uint8_t arg, uint32_t now_ms)
+{
+    for (uint8_t i = 0; i < TRANSITION_COUNT; i++) {
+        if (pgm_read_byte(&transitions[i].from) == fsm->state && pgm_read_byte(&transitions[i].to) == to) {
+            take(fsm, i, arg, now_ms);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// owner side: dispatches VAULT_EV_TIMEOUT once the current state's timeout has run out
+uint8_t vault_fsm_poll(vault_fsm_t *fsm, uint32_t now_ms)
+{
+    uint16_t timeout = pgm_read_word(&state_timeout_ms[fsm->state]);
+
+    if (timeout && now_ms - fsm->entered_ms >= timeout)
+        return vault_fsm_dispatch(fsm, VAULT_EV_TIMEOUT, 0, now_ms);
+    return 0;
+}
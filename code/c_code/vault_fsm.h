@@ -0,0 +1,69 @@
+/*
+Header file for the vault state machine shared by both ATmega firmwares
+
+The unlock flow lives in one transition table (vault_fsm.c) that both firmwares link. The keypad MCU owns the
+flow: it turns its inputs into events, dispatches them, polls the state timeouts, and sends every new state to
+the LCD MCU as MCU_MSG_STAGE (arg = VAULT_*). The LCD MCU follows: it looks up the row from its own state to the
+received one, so both sides run the same transitions and an out-of-order stage is rejected instead of drawn.
+
+Each firmware supplies its own action handlers (the keypad resets its PIN entry, the LCD draws the screen and
+drives the door) in an array indexed by VAULT_ACT_*. Dispatching is a table scan plus one handler call.
+
+Nothing here touches hardware, and the current time is passed in, so the table can be stepped on the host
+(-DHAL_HOST).
+*/
+
+#ifndef VAULT_FSM_H_
+#define VAULT_FSM_H_
+
+#include <stdint.h>
+
+// states, sent as the MCU_MSG_STAGE argument
+#define VAULT_LOCKED 0          // box closed, waiting for a fingerprint
+#define VAULT_COMBINATION 1     // door open, waiting for the knobs and switches
+#define VAULT_PIN 2             // combination accepted, waiting for the PIN
+#define VAULT_WRONG_PIN 3
+#define VAULT_UNLOCKED 4
+#define VAULT_STATE_COUNT 5
+
+// events
+#define VAULT_EV_IDENTITY 0         // arg = identity code (1 = Jeevan, 2 = Yongwoo, 3 = Tomas)
+#define VAULT_EV_COMBINATION_OK 1   // all six controls in position
+#define VAULT_EV_COMBINATION_LOST 2 // a control left its position
+#define VAULT_EV_PIN_OK 3
+#define VAULT_EV_PIN_WRONG 4
+#define VAULT_EV_LOCK 5             // * pressed while unlocked
+#define VAULT_EV_TIMEOUT 6          // the state's timeout ran out (vault_fsm_poll())
+
+// actions, run on the transition into the new state
+#define VAULT_ACT_NONE 0
+#define VAULT_ACT_START 1           // identity accepted: open the door, ask for the combination
+#define VAULT_ACT_COMBINATION 2     // combination lost: back to the combination screen
+#define VAULT_ACT_PIN 3             // combination accepted: ask for the PIN
+#define VAULT_ACT_WRONG_PIN 4
+#define VAULT_ACT_RETRY 5           // wrong PIN shown long enough: ask for the PIN again
+#define VAULT_ACT_UNLOCK 6
+#define VAULT_ACT_LOCK 7            // close the box
+#define VAULT_ACTION_COUNT 8
+
+typedef void (*vault_action_t)(uint8_t arg);
+
+typedef struct {
+    uint8_t from;
+    uint8_t event;
+    uint8_t to;
+    uint8_t action;
+} vault_transition_t;
+
+typedef struct {
+    uint8_t state;
+    uint32_t entered_ms;                // when the current state was entered, for its timeout
+    const vault_action_t *actions;      // VAULT_ACTION_COUNT handlers, NULL entries do nothing
+} vault_fsm_t;
+
+void vault_fsm_init(vault_fsm_t *fsm, const vault_action_t *actions, uint32_t now_ms);
+uint8_t vault_fsm_dispatch(vault_fsm_t *fsm, uint8_t event, uint8_t arg, uint32_t now_ms);
+uint8_t vault_fsm_follow(vault_fsm_t *fsm, uint8_t to, uint8_t arg, uint32_t now_ms);
+uint8_t vault_fsm_poll(vault_fsm_t *fsm, uint32_t now_ms);
+
+#endif /* VAULT_FSM_H_ */
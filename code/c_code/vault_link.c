@@ -0,0 +1,125 @@
+/*
+Receiver for the ESP32 -> LCD MCU framed serial link
+*/
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/crc16.h>
+#include "vault_link.h"
+
+#define VAULT_LINK_UBRR (((F_CPU + 4 * VAULT_LINK_BAUD) / (8 * VAULT_LINK_BAUD)) - 1)
+
+volatile uint8_t vault_link_crc_errors = 0;
+volatile uint8_t vault_link_lost = 0;
+
+// frame assembly (ISR only)
+static uint8_t rx_buf[VAULT_LINK_FRAME_SIZE];
+static uint8_t rx_index = 0;
+static uint8_t next_seq = 0;
+static uint8_t seq_valid = 0;
+
+// completed frames: head is written by the ISR, tail by the main loop
+static vault_link_frame_t queue[VAULT_LINK_QUEUE];
+static volatile uint8_t queue_head = 0;
+static volatile uint8_t queue_tail = 0;
+
+void vault_link_init(void)
+{
+    UBRR0H = (uint8_t)(VAULT_LINK_UBRR >> 8);
+    UBRR0L = (uint8_t)VAULT_LINK_UBRR;
+    UCSR0A = (1 << U2X0);                       // double speed for an exact divisor
+    UCSR0C = (1 << UCSZ01) | (1 << UCSZ00);     // 8N1
+    UCSR0B = (1 << RXEN0) | (1 << RXCIE0);      // receiver + RX complete interrupt only
+
+    sei();
+}
+
+// returns 1 and copies the oldest frame if one is waiting
+uint8_t vault_link_poll(vault_link_frame_t *frame)
+{
+    uint8_t tail = queue_tail;
+    if (tail == queue_head)
+        return 0;
+
+    *frame = queue[tail];
+    queue_tail = (tail + 1) & (VAULT_LINK_QUEUE - 1);
+    return 1;
+}
+
+// drops every frame received so far
+void vault_link_flush(void)
+{
+    queue_tail = queue_head;
+}
+
+// returns 0 if the CRC doesn't match, the frame is then left in rx_buf for resync()
+static uint8_t frame_complete(void)
+{
+    uint8_t crc = 0;
+    for (uint8_t i = 1; i < VAULT_LINK_FRAME_SIZE - 1; i++)
+        crc = _crc8_ccitt_update(crc, rx_buf[i]);
+
+    if (crc != rx_buf[VAULT_LINK_FRAME_SIZE - 1]) {
+        vault_link_crc_errors++;
+        return 0;
+    }
+
+    uint8_t seq = rx_buf[1];
+    if (seq_valid && seq != next_seq)
+        vault_link_lost += (uint8_t)(seq - next_seq);
+    next_seq = seq + 1;
+    seq_valid = 1;
+
+    uint8_t head = queue_head;
+    uint8_t next = (head + 1) & (VAULT_LINK_QUEUE - 1);
+    if (next == queue_tail) {
+        vault_link_lost++;
+        return 1;
+    }
+
+    queue[head].seq = seq;
+    queue[head].type = rx_buf[2];
+    queue[head].id = rx_buf[3] | (rx_buf[4] << 8);
+    queue[head].confidence = rx_buf[5] | (rx_buf[6] << 8);
+    queue_head = next;
+    return 1;
+}
+
+// bad frame: the real one may start inside it (a 0xA5 in the noise was taken for sync), so keep everything
+// from the next sync byte after rx_buf[0] and carry on assembling; returns how many bytes were kept
+static uint8_t resync(void)
+{
+    uint8_t start = 1;
+    while (start < VAULT_LINK_FRAME_SIZE && rx_buf[start] != VAULT_LINK_SYNC)
+        start++;
+
+    uint8_t kept = VAULT_LINK_FRAME_SIZE - start;
+    for (uint8_t i = 0; i < kept; i++)
+        rx_buf[i] = rx_buf[start + i];
+    return kept;
+}
+
+ISR(USART0_RX_vect)
+{
+    uint8_t status = UCSR0A;
+    uint8_t data = UDR0;
+
+    // framing error or overrun: whatever was being assembled is garbage
+    if (status & ((1 << FE0) | (1 << DOR0))) {
+        vault_link_crc_errors++;
+        rx_index = 0;
+        return;
+    }
+
+    // hunt for the sync byte between frames
+    if (rx_index == 0 && data != VAULT_LINK_SYNC)
+        return;
+
+    rx_buf[rx_index++] = data;
+
+    if (rx_index == VAULT_LINK_FRAME_SIZE)
+        rx_index = frame_complete() ? 0 : resync();
+}
@@ -0,0 +1,45 @@
+/*
+Header file for the framed serial link from the ESP32 (fingerprint sensor) to the LCD MCU
+
+Replaces the 2-bit identity bus on PC1/PC2. The ESP32 sends one 8-byte frame per event:
+
+    | 0xA5 | seq | type | id lo | id hi | confidence lo | confidence hi | CRC-8 |
+
+CRC-8/CCITT (_crc8_ccitt_update, init 0) covers seq..confidence. The sender is VaultLink.cpp in c++_code,
+keep both sides in step.
+
+Wiring: ESP32 GPIO10 --> PD0 (RXD0). USART0 RX belongs to this driver, so the LCD firmware must not call
+uart_init().
+*/
+
+#ifndef VAULT_LINK_H_
+#define VAULT_LINK_H_
+
+#include <avr/io.h>
+#include <stdint.h>
+
+#define VAULT_LINK_BAUD 250000UL   // exact with U2X0 at 16 MHz (UBRR0 = 7)
+#define VAULT_LINK_SYNC 0xA5
+#define VAULT_LINK_FRAME_SIZE 8
+#define VAULT_LINK_QUEUE 4         // received frames buffered, power of 2
+
+// event types (vaultLinkEvent_t on the ESP32)
+#define VAULT_LINK_IDENTITY 1      // finger matched, id/confidence valid
+#define VAULT_LINK_REJECT 2        // finger did not match
+#define VAULT_LINK_RESET 3         // ESP32 saw the reset line
+
+typedef struct {
+    uint8_t seq;
+    uint8_t type;
+    uint16_t id;            // R503 template ID
+    uint16_t confidence;
+} vault_link_frame_t;
+
+extern volatile uint8_t vault_link_crc_errors;  // frames discarded for a bad CRC or framing error
+extern volatile uint8_t vault_link_lost;        // frames missed (sequence gaps or full queue)
+
+void vault_link_init(void);
+uint8_t vault_link_poll(vault_link_frame_t *frame);
+void vault_link_flush(void);
+
+#endif /* VAULT_LINK_H_ */
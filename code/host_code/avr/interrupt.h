@@ -0,0 +1,12 @@
+/*
+ * avr/interrupt.h for host builds - an ISR is an ordinary function named after its vector, called by the check
+ */
+
+#ifndef AVR_HOST_INTERRUPT_H_
+#define AVR_HOST_INTERRUPT_H_
+
+#define ISR(vector) void vector(void)
+#define sei() ((void)0)
+#define cli() ((void)0)
+
+#endif /* AVR_HOST_INTERRUPT_H_ */
@@ -0,0 +1,78 @@
+/*
+ * avr/io.h for host builds - the ATmega328PB registers the drivers use that hal.h doesn't cover (timers,
+ * pin-change interrupts, the ports of drivers not on the HAL yet), as plain variables defined in avr_host.c
+ *
+ * Put code/host_code first on the include path (-I.) so the drivers pick this up instead of avr-libc. Nothing
+ * behind a register happens by itself: a check sets the flags and calls the ISRs (avr/interrupt.h) itself.
+ */
+
+#ifndef AVR_HOST_IO_H_
+#define AVR_HOST_IO_H_
+
+#include <stdint.h>
+
+// pin numbers, the same as hal.h's host section
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PC0 0
+#define PC1 1
+#define PC2 2
+#define PC3 3
+#define PC4 4
+#define PC5 5
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+
+// ---------------------------------- ports -------------------------------------------
+extern volatile uint8_t DDRB, PORTB, PINB, DDRC, PORTC, PINC, DDRD, PORTD, PIND;
+
+// ---------------------------------- pin-change interrupts ---------------------------
+extern volatile uint8_t PCICR, PCIFR, PCMSK0, PCMSK1, PCMSK2;
+#define PCIE0 0
+#define PCIE1 1
+#define PCIE2 2
+#define PCIF0 0
+#define PCIF1 1
+#define PCIF2 2
+
+// ---------------------------------- Timer0 ------------------------------------------
+extern volatile uint8_t TCCR0A, TCCR0B, TCNT0, OCR0A, TIMSK0;
+#define WGM00 0
+#define WGM01 1
+#define COM0A1 7
+#define CS00 0
+#define CS01 1
+#define CS02 2
+#define OCIE0A 1
+
+// ---------------------------------- Timer2 ------------------------------------------
+extern volatile uint8_t TCCR2A, TCCR2B, TCNT2, OCR2B;
+#define WGM20 0
+#define WGM21 1
+#define COM2B0 4
+#define COM2B1 5
+#define CS20 0
+#define CS21 1
+
+// ---------------------------------- Timer4 ------------------------------------------
+extern volatile uint8_t TCCR4A, TCCR4B, TIMSK4, TIFR4;
+extern volatile uint16_t ICR4, OCR4B;
+#define WGM41 1
+#define COM4B1 5
+#define CS41 1
+#define WGM42 3
+#define WGM43 4
+#define TOIE4 0
+#define TOV4 0
+
+#endif /* AVR_HOST_IO_H_ */
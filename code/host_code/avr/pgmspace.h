@@ -0,0 +1,14 @@
+/*
+ * avr/pgmspace.h for host builds - flash tables are ordinary const data, as in hal.h's host section
+ */
+
+#ifndef AVR_HOST_PGMSPACE_H_
+#define AVR_HOST_PGMSPACE_H_
+
+#include <stdint.h>
+
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+
+#endif /* AVR_HOST_PGMSPACE_H_ */
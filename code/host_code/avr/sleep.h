@@ -0,0 +1,18 @@
+/*
+ * avr/sleep.h for host builds - sleeping returns at once, the check moves time on itself
+ */
+
+#ifndef AVR_HOST_SLEEP_H_
+#define AVR_HOST_SLEEP_H_
+
+#define SLEEP_MODE_IDLE 0
+#define SLEEP_MODE_PWR_DOWN 2
+
+#define set_sleep_mode(mode) ((void)(mode))
+#define sleep_enable() ((void)0)
+#define sleep_disable() ((void)0)
+#define sleep_cpu() ((void)0)
+#define sleep_mode() ((void)0)
+#define sleep_bod_disable() ((void)0)
+
+#endif /* AVR_HOST_SLEEP_H_ */
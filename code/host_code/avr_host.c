@@ -0,0 +1,19 @@
+/*
+ * avr_host.c - the registers declared by the host avr/io.h
+ *
+ * Build alongside hal_host.c when a driver touches registers directly, e.g. (from code/host_code):
+ *   gcc -O2 -std=gnu99 -DHAL_HOST -I. -I../c_code ../c_code/keypad.c hal_host.c avr_host.c keypad_check.c
+ */
+
+#include <avr/io.h>
+
+volatile uint8_t DDRB, PORTB, PINB, DDRC, PORTC, PINC, DDRD, PORTD, PIND;
+
+volatile uint8_t PCICR, PCIFR, PCMSK0, PCMSK1, PCMSK2;
+
+volatile uint8_t TCCR0A, TCCR0B, TCNT0, OCR0A, TIMSK0;
+
+volatile uint8_t TCCR2A, TCCR2B, TCNT2, OCR2B;
+
+volatile uint8_t TCCR4A, TCCR4B, TIMSK4, TIFR4;
+volatile uint16_t ICR4, OCR4B;
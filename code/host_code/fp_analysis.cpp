@@ -0,0 +1,445 @@
+/**
+ * @file fp_analysis.cpp
+ * @brief Host-side analysis of fingerprint images downloaded from the R503.
+ *
+ * Orientation is estimated per block with the least-squares gradient method: the doubled ridge angle
+ * is taken from (Gxx - Gyy, 2Gxy) and the block coherence from its magnitude over (Gxx + Gyy).
+ * Storing the doubled angle as a unit vector keeps comparisons free of trigonometry.
+ */
+
+#include "fp_analysis.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <thread>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define FP_USE_SSE2 1
+#endif
+
+/* --------------------------
+    ? Image Loading
+----------------------------*/
+
+/**
+ * @brief Loads a raw image dump as produced by R503Lib::downloadImage().
+ *
+ * @param path File to read.
+ * @param width Sensor width in pixels (R503DeviceInfo::sensorWidth).
+ * @param height Sensor height in pixels (R503DeviceInfo::sensorHeight).
+ * @param format Pixel packing of the dump.
+ * @param image The image to populate, pixels are expanded to 0-255.
+ *
+ * @return true if the file exists and has exactly the expected size.
+ */
+bool fpLoadImage(const std::string &path, uint16_t width, uint16_t height, fpFormat_t format, FpImage &image)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    std::vector<uint8_t> raw((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    size_t pixelCount = (size_t)width * height;
+    size_t expected = (format == fpFormatPacked4) ? pixelCount / 2 : pixelCount;
+
+    if (raw.size() != expected)
+        return false;
+
+    image.name = path;
+    image.width = width;
+    image.height = height;
+    image.pixels.resize(pixelCount);
+
+    if (format == fpFormatPacked4)
+    {
+        for (size_t i = 0; i < raw.size(); i++)
+        {
+            image.pixels[2 * i] = (raw[i] >> 4) * 17;
+            image.pixels[2 * i + 1] = (raw[i] & 0x0F) * 17;
+        }
+    }
+    else
+    {
+        image.pixels = raw;
+    }
+
+    return true;
+}
+
+/* --------------------------
+    ? Kernels
+----------------------------*/
+
+/**
+ * @brief 3x3 Sobel gradients. Border pixels are left at zero.
+ */
+static void sobel(const uint8_t *src, int w, int h, int16_t *gx, int16_t *gy)
+{
+    std::fill(gx, gx + (size_t)w * h, 0);
+    std::fill(gy, gy + (size_t)w * h, 0);
+
+    for (int y = 1; y < h - 1; y++)
+    {
+        const uint8_t *r0 = src + (size_t)(y - 1) * w;
+        const uint8_t *r1 = r0 + w;
+        const uint8_t *r2 = r1 + w;
+        int16_t *ox = gx + (size_t)y * w;
+        int16_t *oy = gy + (size_t)y * w;
+        int x = 1;
+
+#if FP_USE_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        for (; x + 8 < w; x += 8)
+        {
+            __m128i a0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(r0 + x - 1)), zero);
+            __m128i b0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(r0 + x)), zero);
+            __m128i c0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(r0 + x + 1)), zero);
+            __m128i a1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(r1 + x - 1)), zero);
+            __m128i c1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(r1 + x + 1)), zero);
+            __m128i a2 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(r2 + x - 1)), zero);
+            __m128i b2 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(r2 + x)), zero);
+            __m128i c2 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(r2 + x + 1)), zero);
+
+            __m128i dx = _mm_add_epi16(_mm_sub_epi16(c0, a0), _mm_sub_epi16(c2, a2));
+            dx = _mm_add_epi16(dx, _mm_slli_epi16(_mm_sub_epi16(c1, a1), 1));
+            __m128i dy = _mm_add_epi16(_mm_sub_epi16(a2, a0), _mm_sub_epi16(c2, c0));
+            dy = _mm_add_epi16(dy, _mm_slli_epi16(_mm_sub_epi16(b2, b0), 1));
+
+            _mm_storeu_si128((__m128i *)(ox + x), dx);
+            _mm_storeu_si128((__m128i *)(oy + x), dy);
+        }
+#endif
+
+        for (; x < w - 1; x++)
+        {
+            ox[x] = (r0[x + 1] - r0[x - 1]) + 2 * (r1[x + 1] - r1[x - 1]) + (r2[x + 1] - r2[x - 1]);
+            oy[x] = (r2[x - 1] - r0[x - 1]) + 2 * (r2[x] - r0[x]) + (r2[x + 1] - r0[x + 1]);
+        }
+    }
+}
+
+struct BlockSums
+{
+    int64_t gxx, gyy, gxy;
+    int64_t sum, sumSq;
+};
+
+#if FP_USE_SSE2
+static inline int64_t hsum32(__m128i v)
+{
+    int32_t lanes[4];
+    _mm_storeu_si128((__m128i *)lanes, v);
+    return (int64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+#endif
+
+/**
+ * @brief Accumulates gradient moments and intensity statistics for one block.
+ */
+static BlockSums blockSums(const uint8_t *px, const int16_t *gx, const int16_t *gy, int w, int x0, int y0, int bs)
+{
+    BlockSums s = {0, 0, 0, 0, 0};
+
+    for (int y = y0; y < y0 + bs; y++)
+    {
+        size_t row = (size_t)y * w;
+        int x = x0;
+
+#if FP_USE_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        __m128i xx = zero, yy = zero, xy = zero, sq = zero, sum = zero;
+        for (; x + 8 <= x0 + bs; x += 8)
+        {
+            __m128i vx = _mm_loadu_si128((const __m128i *)(gx + row + x));
+            __m128i vy = _mm_loadu_si128((const __m128i *)(gy + row + x));
+            xx = _mm_add_epi32(xx, _mm_madd_epi16(vx, vx));
+            yy = _mm_add_epi32(yy, _mm_madd_epi16(vy, vy));
+            xy = _mm_add_epi32(xy, _mm_madd_epi16(vx, vy));
+
+            __m128i p8 = _mm_loadl_epi64((const __m128i *)(px + row + x));
+            __m128i p16 = _mm_unpacklo_epi8(p8, zero);
+            sq = _mm_add_epi32(sq, _mm_madd_epi16(p16, p16));
+            sum = _mm_add_epi64(sum, _mm_sad_epu8(p8, zero));
+        }
+        s.gxx += hsum32(xx);
+        s.gyy += hsum32(yy);
+        s.gxy += hsum32(xy);
+        s.sumSq += hsum32(sq);
+        s.sum += _mm_cvtsi128_si32(sum);
+#endif
+
+        for (; x < x0 + bs; x++)
+        {
+            int32_t vx = gx[row + x], vy = gy[row + x], p = px[row + x];
+            s.gxx += vx * vx;
+            s.gyy += vy * vy;
+            s.gxy += vx * vy;
+            s.sum += p;
+            s.sumSq += p * p;
+        }
+    }
+
+    return s;
+}
+
+/* --------------------------
+    ? Analysis
+----------------------------*/
+
+/**
+ * @brief Computes the orientation field and quality map of an image.
+ *
+ * @param image The image to analyze.
+ * @param blockSize Block edge in pixels (8 to 64). Partial blocks at the right/bottom edge are ignored.
+ * @param result The analysis to populate.
+ *
+ * @return false if the block size is out of range or the image is smaller than one block.
+ */
+bool fpAnalyze(const FpImage &image, uint16_t blockSize, FpAnalysis &result)
+{
+    int w = image.width, h = image.height, bs = blockSize;
+
+    if (bs < 8 || bs > 64 || w < bs || h < bs || image.pixels.size() != (size_t)w * h)
+        return false;
+
+    std::vector<int16_t> gx((size_t)w * h), gy((size_t)w * h);
+    sobel(image.pixels.data(), w, h, gx.data(), gy.data());
+
+    result.name = image.name;
+    result.blocksX = w / bs;
+    result.blocksY = h / bs;
+
+    size_t blocks = (size_t)result.blocksX * result.blocksY;
+    result.orientCos.assign(blocks, 0.0f);
+    result.orientSin.assign(blocks, 0.0f);
+    result.coherence.assign(blocks, 0.0f);
+    result.quality.assign(blocks, 0.0f);
+
+    size_t foreground = 0;
+    float qualitySum = 0.0f;
+    float n = (float)(bs * bs);
+
+    for (int by = 0; by < result.blocksY; by++)
+    {
+        for (int bx = 0; bx < result.blocksX; bx++)
+        {
+            size_t i = (size_t)by * result.blocksX + bx;
+            BlockSums s = blockSums(image.pixels.data(), gx.data(), gy.data(), w, bx * bs, by * bs, bs);
+
+            float mean = s.sum / n;
+            float stddev = std::sqrt(std::max(0.0f, s.sumSq / n - mean * mean));
+            if (stddev < FP_FOREGROUND_STDDEV)
+                continue;
+
+            double diff = (double)s.gxx - s.gyy;
+            double cross = 2.0 * s.gxy;
+            double norm = std::sqrt(diff * diff + cross * cross);
+            double energy = (double)s.gxx + s.gyy;
+            if (norm <= 0.0 || energy <= 0.0)
+                continue;
+
+            // Ridges run perpendicular to the gradient, which negates the doubled angle vector
+            result.orientCos[i] = (float)(-diff / norm);
+            result.orientSin[i] = (float)(-cross / norm);
+            result.coherence[i] = (float)(norm / energy);
+            result.quality[i] = result.coherence[i] * std::min(1.0f, stddev / FP_CONTRAST_REFERENCE);
+
+            foreground++;
+            qualitySum += result.quality[i];
+        }
+    }
+
+    result.foreground = (float)foreground / blocks;
+    result.meanQuality = foreground ? qualitySum / foreground : 0.0f;
+
+    return true;
+}
+
+/**
+ * @brief Weighted orientation agreement of one row segment.
+ *
+ * Blocks count when both sides are foreground (non-zero coherence); the weight is the product of coherences.
+ */
+static void rowAgreement(const float *ca, const float *sa, const float *wa,
+                         const float *cb, const float *sb, const float *wb,
+                         int count, float &num, float &den, int &overlap)
+{
+    int i = 0;
+
+#if FP_USE_SSE2
+    const __m128 zero = _mm_setzero_ps();
+    __m128 vnum = zero, vden = zero;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 w1 = _mm_loadu_ps(wa + i);
+        __m128 w2 = _mm_loadu_ps(wb + i);
+        __m128 mask = _mm_and_ps(_mm_cmpgt_ps(w1, zero), _mm_cmpgt_ps(w2, zero));
+        __m128 weight = _mm_and_ps(_mm_mul_ps(w1, w2), mask);
+        __m128 dot = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(ca + i), _mm_loadu_ps(cb + i)),
+                                _mm_mul_ps(_mm_loadu_ps(sa + i), _mm_loadu_ps(sb + i)));
+        vnum = _mm_add_ps(vnum, _mm_mul_ps(weight, dot));
+        vden = _mm_add_ps(vden, weight);
+        overlap += __builtin_popcount(_mm_movemask_ps(mask));
+    }
+
+    float lanes[4];
+    _mm_storeu_ps(lanes, vnum);
+    num += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm_storeu_ps(lanes, vden);
+    den += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+
+    for (; i < count; i++)
+    {
+        if (wa[i] > 0.0f && wb[i] > 0.0f)
+        {
+            float weight = wa[i] * wb[i];
+            num += weight * (ca[i] * cb[i] + sa[i] * sb[i]);
+            den += weight;
+            overlap++;
+        }
+    }
+}
+
+/**
+ * @brief Compares two orientation fields.
+ *
+ * The fields are shifted against each other by up to FP_MAX_SHIFT blocks in each direction to absorb
+ * finger placement; the best coherence-weighted cos(2 * dtheta) is returned.
+ *
+ * @return Similarity in -1 .. 1, or 0 if the fields have different geometry or do not overlap enough.
+ */
+float fpSimilarity(const FpAnalysis &a, const FpAnalysis &b)
+{
+    if (a.blocksX != b.blocksX || a.blocksY != b.blocksY)
+        return 0.0f;
+
+    int bx = a.blocksX, by = a.blocksY;
+    float fgA = a.foreground * bx * by;
+    float fgB = b.foreground * bx * by;
+    float minForeground = std::min(fgA, fgB);
+    if (minForeground <= 0.0f)
+        return 0.0f;
+
+    float best = 0.0f;
+
+    for (int dy = -FP_MAX_SHIFT; dy <= FP_MAX_SHIFT; dy++)
+    {
+        for (int dx = -FP_MAX_SHIFT; dx <= FP_MAX_SHIFT; dx++)
+        {
+            float num = 0.0f, den = 0.0f;
+            int overlap = 0;
+
+            int xa = std::max(0, -dx), xb = std::max(0, dx);
+            int width = bx - std::abs(dx);
+
+            for (int y = std::max(0, -dy); y < by && y + dy < by; y++)
+            {
+                size_t ra = (size_t)y * bx + xa;
+                size_t rb = (size_t)(y + dy) * bx + xb;
+                rowAgreement(&a.orientCos[ra], &a.orientSin[ra], &a.coherence[ra],
+                             &b.orientCos[rb], &b.orientSin[rb], &b.coherence[rb],
+                             width, num, den, overlap);
+            }
+
+            if (overlap < FP_MIN_OVERLAP * minForeground || den <= 0.0f)
+                continue;
+
+            best = std::max(best, num / den);
+        }
+    }
+
+    return best;
+}
+
+/* --------------------------
+    ? Batch Processing
+----------------------------*/
+
+static unsigned workerCount(unsigned threads, size_t jobs)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    return (unsigned)std::min<size_t>(threads, std::max<size_t>(1, jobs));
+}
+
+/**
+ * @brief Analyzes a batch of images across worker threads.
+ *
+ * @param threads Number of workers, 0 for one per hardware thread.
+ *
+ * @return One analysis per image, in input order. Images that could not be analyzed have no blocks.
+ */
+std::vector<FpAnalysis> fpAnalyzeBatch(const std::vector<FpImage> &images, uint16_t blockSize, unsigned threads)
+{
+    std::vector<FpAnalysis> results(images.size());
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+
+    for (unsigned t = 0; t < workerCount(threads, images.size()); t++)
+    {
+        workers.emplace_back([&]() {
+            for (size_t i = next++; i < images.size(); i = next++)
+            {
+                if (!fpAnalyze(images[i], blockSize, results[i]))
+                {
+                    results[i] = FpAnalysis();
+                    results[i].name = images[i].name;
+                }
+            }
+        });
+    }
+
+    for (std::thread &worker : workers)
+        worker.join();
+
+    return results;
+}
+
+/**
+ * @brief Compares every pair of fields and reports those at or above a similarity threshold.
+ *
+ * @param threshold Minimum similarity to report (see fpSimilarity()).
+ * @param threads Number of workers, 0 for one per hardware thread.
+ *
+ * @return Matching pairs, most similar first.
+ */
+std::vector<FpDuplicate> fpFindDuplicates(const std::vector<FpAnalysis> &fields, float threshold, unsigned threads)
+{
+    std::vector<std::vector<FpDuplicate>> found(workerCount(threads, fields.size()));
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+
+    for (size_t t = 0; t < found.size(); t++)
+    {
+        workers.emplace_back([&, t]() {
+            for (size_t i = next++; i < fields.size(); i = next++)
+            {
+                for (size_t j = i + 1; j < fields.size(); j++)
+                {
+                    float similarity = fpSimilarity(fields[i], fields[j]);
+                    if (similarity >= threshold)
+                        found[t].push_back({i, j, similarity});
+                }
+            }
+        });
+    }
+
+    for (std::thread &worker : workers)
+        worker.join();
+
+    std::vector<FpDuplicate> duplicates;
+    for (const std::vector<FpDuplicate> &part : found)
+        duplicates.insert(duplicates.end(), part.begin(), part.end());
+
+    std::sort(duplicates.begin(), duplicates.end(), [](const FpDuplicate &x, const FpDuplicate &y) {
+        return x.similarity > y.similarity;
+    });
+
+    return duplicates;
+}
@@ -0,0 +1,78 @@
+/**
+ * @file fp_analysis.h
+ * @brief Host-side analysis of fingerprint images downloaded from the R503.
+ *
+ * Images pulled off the sensor with R503Lib::downloadImage() are loaded here and reduced to
+ * block-wise orientation fields and quality maps. Two fields can then be compared to flag
+ * enrollment captures that are likely the same finger.
+ *
+ * The per-pixel kernels use SSE2 when the compiler targets it and fall back to plain C++ otherwise.
+ * Batches are spread across all cores with fpAnalyzeBatch() / fpFindDuplicates().
+ *
+ * Build (Linux): g++ -O3 -march=native -std=c++17 -pthread fp_analysis.cpp fp_audit.cpp -o fp_audit
+ */
+
+#ifndef FP_ANALYSIS_H
+#define FP_ANALYSIS_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// R503 defaults (R503DeviceInfo::sensorWidth / sensorHeight)
+#define FP_DEFAULT_WIDTH 192
+#define FP_DEFAULT_HEIGHT 192
+#define FP_DEFAULT_BLOCK 16
+
+// Foreground blocks need at least this intensity standard deviation (0-255 scale)
+#define FP_FOREGROUND_STDDEV 12.0f
+// Standard deviation at which a block's contrast counts as "good"
+#define FP_CONTRAST_REFERENCE 48.0f
+// Fields that share fewer foreground blocks than this fraction are not compared
+#define FP_MIN_OVERLAP 0.4f
+// Block shift searched in each direction when comparing two fields
+#define FP_MAX_SHIFT 2
+
+typedef enum
+{
+    fpFormatPacked4 = 1, // Sensor upload format: 2 pixels per byte, high nibble first
+    fpFormatRaw8,        // One byte per pixel
+} fpFormat_t;
+
+struct FpImage
+{
+    std::string name;
+    uint16_t width;
+    uint16_t height;
+    std::vector<uint8_t> pixels; // width * height, 0-255
+};
+
+struct FpAnalysis
+{
+    std::string name;
+    uint16_t blocksX;
+    uint16_t blocksY;
+    std::vector<float> orientCos; // cos(2 * theta) per block
+    std::vector<float> orientSin; // sin(2 * theta) per block
+    std::vector<float> coherence; // 0 (no dominant ridge direction) .. 1
+    std::vector<float> quality;   // 0 .. 1, 0 for background blocks
+    float foreground;             // fraction of foreground blocks
+    float meanQuality;            // mean quality over foreground blocks
+};
+
+struct FpDuplicate
+{
+    size_t first;
+    size_t second;
+    float similarity;
+};
+
+bool fpLoadImage(const std::string &path, uint16_t width, uint16_t height, fpFormat_t format, FpImage &image);
+
+bool fpAnalyze(const FpImage &image, uint16_t blockSize, FpAnalysis &result);
+float fpSimilarity(const FpAnalysis &a, const FpAnalysis &b);
+
+std::vector<FpAnalysis> fpAnalyzeBatch(const std::vector<FpImage> &images, uint16_t blockSize, unsigned threads);
+std::vector<FpDuplicate> fpFindDuplicates(const std::vector<FpAnalysis> &fields, float threshold, unsigned threads);
+
+#endif
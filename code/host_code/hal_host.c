@@ -0,0 +1,142 @@
+/*
+ * hal_host.c - Linux backend for c_code/hal.h
+ *
+ * Lets the ATmega drivers (ST7735_new.c, LCD_GFX_new.c, uart.c) build and run natively. Nothing is timed: the
+ * delays return at once and are only added up, SPI and UART bytes are counted and passed to optional hooks, and
+ * the ports are a DDR/PORT/PIN model in which an input reads its pull-up level unless hal_host_set_pins() or
+ * hal_host_pin_hook says otherwise.
+ *
+ * Build with the drivers and a program that calls them, e.g. (from code/host_code):
+ *   gcc -O2 -DHAL_HOST -I../c_code ../c_code/ST7735_new.c ../c_code/LCD_GFX_new.c hal_host.c lcd_bench.c -lm
+ */
+
+#include "hal.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#define HAL_HOST_ADC_CHANNELS 8
+#define HAL_HOST_UART_INPUT 256
+
+hal_host_stats_t hal_host_stats;
+
+void (*hal_host_spi_hook)(uint8_t data);
+void (*hal_host_uart_hook)(uint8_t data);
+uint8_t (*hal_host_pin_hook)(hal_port_t port, uint8_t latch);
+
+static uint8_t port_latch[HAL_PORT_COUNT];
+static uint8_t port_ddr[HAL_PORT_COUNT];
+static uint8_t port_pins[HAL_PORT_COUNT];       // externally driven levels on the input bits
+static uint8_t port_driven[HAL_PORT_COUNT];     // which input bits hal_host_set_pins() has driven
+
+static uint16_t adc_value[HAL_HOST_ADC_CHANNELS];
+
+static char uart_input[HAL_HOST_UART_INPUT];
+static size_t uart_head, uart_tail;
+
+void hal_host_reset(void)
+{
+    memset(&hal_host_stats, 0, sizeof(hal_host_stats));
+}
+
+uint8_t hal_host_latch(hal_port_t port)
+{
+    return port_latch[port];
+}
+
+void hal_host_set_pins(hal_port_t port, uint8_t value)
+{
+    port_pins[port] = value;
+    port_driven[port] = 0xFF;
+}
+
+void hal_host_set_adc(uint8_t channel, uint16_t value)
+{
+    adc_value[channel & (HAL_HOST_ADC_CHANNELS - 1)] = value & 0x3FF;
+}
+
+void hal_host_uart_input(const char *text)
+{
+    while (*text && uart_tail - uart_head < HAL_HOST_UART_INPUT)
+        uart_input[uart_tail++ % HAL_HOST_UART_INPUT] = *text++;
+}
+
+// ---------------------------------- GPIO -------------------------------------------
+static void latch_write(hal_port_t port, uint8_t value)
+{
+    uint8_t changed = (uint8_t)((port_latch[port] ^ value) & port_ddr[port]);
+    for (; changed; changed &= changed - 1)
+        hal_host_stats.gpio_edges++;
+    port_latch[port] = value;
+}
+
+void hal_gpio_output(hal_port_t port, uint8_t mask) { port_ddr[port] |= mask; }
+void hal_gpio_input(hal_port_t port, uint8_t mask) { port_ddr[port] &= ~mask; }
+void hal_gpio_high(hal_port_t port, uint8_t mask) { latch_write(port, port_latch[port] | mask); }
+void hal_gpio_low(hal_port_t port, uint8_t mask) { latch_write(port, port_latch[port] & ~mask); }
+
+uint8_t hal_gpio_read(hal_port_t port)
+{
+    if (hal_host_pin_hook)
+        return hal_host_pin_hook(port, port_latch[port]);
+
+    // outputs read back their latch, inputs their driven level or else the pull-up (PORTx bit)
+    uint8_t inputs = (uint8_t)~port_ddr[port];
+    uint8_t level = (uint8_t)((port_pins[port] & port_driven[port]) | (port_latch[port] & ~port_driven[port]));
+    return (uint8_t)((port_latch[port] & ~inputs) | (level & inputs));
+}
+
+// ---------------------------------- SPI0 -------------------------------------------
+void hal_spi_init(void) {}
+
+void hal_spi_write(uint8_t data)
+{
+    hal_host_stats.spi_bytes++;
+    if (hal_host_spi_hook)
+        hal_host_spi_hook(data);
+}
+
+// ---------------------------------- Timer0 PWM -------------------------------------
+void hal_pwm0a_init(uint8_t duty) { hal_host_stats.pwm0a = duty; }
+void hal_pwm0a_set(uint8_t duty) { hal_host_stats.pwm0a = duty; }
+
+// ---------------------------------- USART0 -----------------------------------------
+void hal_uart_init(uint16_t ubrr, uint8_t double_speed, uint8_t two_stop_bits)
+{
+    (void)ubrr;
+    (void)double_speed;
+    (void)two_stop_bits;
+}
+
+void hal_uart_write(uint8_t data)
+{
+    hal_host_stats.uart_bytes++;
+    if (hal_host_uart_hook)
+        hal_host_uart_hook(data);
+}
+
+uint8_t hal_uart_ready(void)
+{
+    return uart_head != uart_tail;
+}
+
+// blocks forever on the AVR once the input runs out; here it returns '\r' so a test can't hang
+uint8_t hal_uart_read(void)
+{
+    if (uart_head == uart_tail)
+        return '\r';
+    return (uint8_t)uart_input[uart_head++ % HAL_HOST_UART_INPUT];
+}
+
+// ---------------------------------- ADC --------------------------------------------
+void hal_adc_init(void) {}
+
+uint16_t hal_adc_read(uint8_t channel)
+{
+    hal_host_stats.delay_us += 10;      // multiplexer settling, as on the AVR
+    return adc_value[channel & (HAL_HOST_ADC_CHANNELS - 1)];
+}
+
+// ---------------------------------- delays -----------------------------------------
+void hal_delay_ms(uint16_t ms) { hal_host_stats.delay_us += (uint64_t)ms * 1000; }
+void hal_delay_us(uint16_t us) { hal_host_stats.delay_us += us; }
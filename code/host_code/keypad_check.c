@@ -0,0 +1,234 @@
+/*
+ * keypad_check.c - native check of the interrupt-driven keypad scanner (keypad.c) against a scripted key matrix
+ *
+ * keypad.c runs on the host HAL (hal_host.c) for its row and column pins and on the host avr/io.h for Timer0
+ * and the pin-change registers. A pin hook plays the 4x4 matrix: a pressed key pulls its column low while its
+ * row is driven low. Time advances 1 ms at a time; every millisecond the Timer0 compare ISR runs if the timer
+ * is on, and a matrix change while the scan is stopped raises the column port's pin-change ISR, as on the board.
+ *
+ * Checks that a 1 ms glitch gives no event, that a press and its release are reported within 16 ms, that
+ * pressing again 12 ms after a release gives a second press, and that a held key repeats after 500 ms and then
+ * every 100 ms. Then each key is pressed in turn and the key codes must read 1 2 3 A 4 5 6 B 7 8 9 C * 0 # D, the
+ * layout in keypad.h. Every event is printed with its time. Exit status is 1 if any check fails.
+ *
+ * Build (from code/host_code):
+ *   gcc -O2 -std=gnu99 -DHAL_HOST -I. -I../c_code ../c_code/keypad.c hal_host.c avr_host.c keypad_check.c \
+ *       -o keypad_check
+ */
+
+#include <avr/io.h>
+#include "hal.h"
+#include "keypad.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define LOG_SIZE 128
+#define KEY_NONE 0xFF
+
+// the ISRs keypad.c defines; a pin-change vector only exists for a port that carries columns
+void TIMER0_COMPA_vect(void);
+void PCINT0_vect(void) __attribute__((weak));
+void PCINT1_vect(void) __attribute__((weak));
+void PCINT2_vect(void) __attribute__((weak));
+
+typedef struct {
+    uint8_t port;
+    uint8_t pin;
+} pin_t;
+
+#define PIN_ENTRY(port, pin) {HAL_PORT##port, pin},
+static const pin_t rows[KEYPAD_ROWS] = {KEYPAD_ROW_PINS(PIN_ENTRY)};
+static const pin_t cols[KEYPAD_COLS] = {KEYPAD_COL_PINS(PIN_ENTRY)};
+
+typedef struct {
+    uint32_t ms;
+    keypad_event_t event;
+} logged_t;
+
+static uint8_t pressed = KEY_NONE;  // matrix index (row * KEYPAD_COLS + col) of the key held down
+static uint32_t now_ms;
+static logged_t log_events[LOG_SIZE];
+static int log_count;
+static int failures;
+
+// ---------------------------------- key matrix --------------------------------------
+// PINx: every pin reads its latch (outputs, and pulled-up inputs), except a column a pressed key pulls low
+static uint8_t matrix_pins(hal_port_t port, uint8_t latch)
+{
+    if (pressed != KEY_NONE) {
+        pin_t row = rows[pressed / KEYPAD_COLS];
+        pin_t col = cols[pressed % KEYPAD_COLS];
+        if (col.port == port && !(hal_host_latch(row.port) & (1 << row.pin)))
+            latch &= ~(1 << col.pin);
+    }
+    return latch;
+}
+
+// a column edge while the scan is stopped: the pin-change interrupt of that port, if it is enabled
+static void pin_change(uint8_t index)
+{
+    static void (*const vectors[])(void) = {PCINT0_vect, PCINT1_vect, PCINT2_vect};
+    uint8_t port = cols[index % KEYPAD_COLS].port;
+
+    if (keypad_idle() && (PCICR & (1 << port)) && vectors[port])
+        vectors[port]();
+}
+
+static void press(uint8_t index)
+{
+    pressed = index;
+    pin_change(index);
+}
+
+static void release(void)
+{
+    uint8_t index = pressed;
+    pressed = KEY_NONE;
+    if (index != KEY_NONE)
+        pin_change(index);
+}
+
+static void run(uint32_t ms)
+{
+    keypad_event_t event;
+
+    while (ms--) {
+        now_ms++;
+        if (TCCR0B)
+            TIMER0_COMPA_vect();
+        while (keypad_get(&event)) {
+            if (log_count < LOG_SIZE)
+                log_events[log_count++] = (logged_t){now_ms, event};
+            printf("  %6u ms  key %2u  %s\n", now_ms, event.key,
+                   event.type == KEYPAD_PRESS ? "press" : event.type == KEYPAD_RELEASE ? "release" : "repeat");
+        }
+    }
+}
+
+// ---------------------------------- checks ------------------------------------------
+static void check(int ok, const char *what)
+{
+    printf("%s %s\n", ok ? "[ok]" : "[X] ", what);
+    if (!ok)
+        failures++;
+}
+
+// log entry index has this type and came within window ms after from
+static int event_at(int index, uint8_t type, uint32_t from, uint32_t window)
+{
+    return index < log_count && log_events[index].event.type == type && log_events[index].ms >= from &&
+           log_events[index].ms <= from + window;
+}
+
+static void check_glitch(void)
+{
+    int first = log_count;
+
+    printf("1 ms glitch on key 5\n");
+    press(5);
+    run(1);
+    release();
+    run(50);
+    check(log_count == first, "a 1 ms glitch gives no event");
+    check(keypad_idle(), "the scan stops again");
+}
+
+static void check_press(void)
+{
+    int first = log_count;
+    uint32_t down, up;
+
+    printf("key 5 held 100 ms\n");
+    down = now_ms;
+    press(5);
+    run(100);
+    up = now_ms;
+    release();
+    run(50);
+    check(log_count == first + 2, "one press and one release");
+    check(event_at(first, KEYPAD_PRESS, down, 16), "press within 16 ms");
+    check(event_at(first + 1, KEYPAD_RELEASE, up, 16), "release within 16 ms");
+}
+
+static void check_double_press(void)
+{
+    int first = log_count;
+    uint32_t again;
+
+    printf("key 5 pressed again 12 ms after a release\n");
+    press(5);
+    run(100);
+    release();
+    run(12);
+    again = now_ms;
+    press(5);
+    run(100);
+    release();
+    run(50);
+    check(log_count == first + 4, "two presses, two releases");
+    check(event_at(first + 2, KEYPAD_PRESS, again, 16), "second press within 16 ms");
+}
+
+static void check_repeat(void)
+{
+    int first = log_count;
+    uint32_t down;
+
+    printf("key 5 held 760 ms\n");
+    press(5);
+    run(760);
+    release();
+    run(50);
+    check(log_count == first + 5, "press, three repeats, release");
+    if (log_count < first + 5)
+        return;
+    down = log_events[first].ms;
+    check(event_at(first + 1, KEYPAD_REPEAT, down + 500 - 4, 8), "first repeat 500 ms after the press");
+    check(event_at(first + 2, KEYPAD_REPEAT, down + 600 - 4, 8), "then every 100 ms");
+    check(event_at(first + 3, KEYPAD_REPEAT, down + 700 - 4, 8), "... and again");
+    check(event_at(first + 4, KEYPAD_RELEASE, down, 800), "release last");
+}
+
+// row by row, the layout KEYPAD_KEYMAP should give
+static void check_keymap(void)
+{
+    static const char expected[] = "123A456B789C*0#D";
+    static const char names[] = "0123456789ABCD*#";
+    char decoded[KEYPAD_KEYS + 1];
+    int first = log_count;
+    int n = 0;
+
+    printf("every key in turn\n");
+    for (uint8_t index = 0; index < KEYPAD_KEYS; index++) {
+        press(index);
+        run(50);
+        release();
+        run(50);
+    }
+    for (int i = first; i < log_count && n < KEYPAD_KEYS; i++)
+        if (log_events[i].event.type == KEYPAD_PRESS)
+            decoded[n++] = (log_events[i].event.key < 16) ? names[log_events[i].event.key] : '?';
+    decoded[n] = '\0';
+    printf("  decoded %s\n", decoded);
+    check(strcmp(decoded, expected) == 0, "keymap decodes 1 2 3 A 4 5 6 B 7 8 9 C * 0 # D");
+}
+
+int main(void)
+{
+    hal_host_reset();
+    hal_host_pin_hook = matrix_pins;
+    keypad_init();
+    run(20);        // the first scan finds nothing and arms the columns
+
+    check(keypad_idle(), "idle keypad stops the scan");
+    check_glitch();
+    check_press();
+    check_double_press();
+    check_repeat();
+    check_keymap();
+    check(keypad_dropped == 0, "no events dropped");
+
+    printf("%d failed\n", failures);
+    return failures ? 1 : 0;
+}
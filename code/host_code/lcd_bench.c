@@ -0,0 +1,238 @@
+/*
+ * lcd_bench.c - native benchmark of the LCD screens through the host HAL (hal_host.c)
+ *
+ * Draws every screen LCD_comms.c shows during an unlock with the real ST7735_new.c / LCD_GFX_new.c code and
+ * reports, per screen, the SPI bytes sent, the GPIO edges (CS/DC toggles), the time the drivers asked to wait,
+ * and the time the same SPI traffic takes on the board at 8 MHz. Screens are kept in step with LCD_comms.c by
+ * hand, so update both together.
+ *
+ * --dump FILE writes every SPI byte as "<screen>,<D|C>,<byte>" lines (D/C from the LCD_DC latch) so a change in
+ * drawing code can be diffed byte for byte.
+ *
+ * Build (from code/host_code):
+ *   gcc -O2 -std=gnu99 -DHAL_HOST -I../c_code ../c_code/ST7735_new.c ../c_code/LCD_GFX_new.c hal_host.c \
+ *       lcd_bench.c -lm -o lcd_bench
+ *
+ * Usage: lcd_bench [--csv] [--repeat N] [--dump FILE]
+ *   --csv          print the results as CSV instead of a table
+ *   --repeat N     draw each screen N times for the native timing (default 100)
+ *   --dump FILE    SPI byte log of one pass
+ */
+
+#include "ST7735_new.h"
+#include "LCD_GFX_new.h"
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define SPI_HZ 8000000UL        // fck/2 with SPI2X, see hal_spi_init()
+
+typedef struct {
+    const char *name;
+    void (*draw)(void);
+} screen_t;
+
+// ---------------------------------- screens (from LCD_comms.c) ---------------------
+static void draw_PIN_digits(uint8_t count)
+{
+    for (uint8_t i = 0; i < 4; i++)
+        LCD_drawString(20 + 10 * i, 80, (i < count) ? "*" : "-", BLUE, WHITE, 8);
+}
+
+static void draw_combination_progress(uint8_t knobs)
+{
+    char text[] = "Set: 0/6";
+    uint8_t count = 0;
+
+    for (uint8_t i = 0; i < 6; i++)
+        count += (knobs >> i) & 1;
+    text[5] = '0' + count;
+    LCD_drawString(29, 70, text, BLUE, WHITE, 8);
+}
+
+static void screen_locked(void)
+{
+    LCD_setScreen(WHITE);
+    LCD_drawString(20, 50, "System Locked", RED, WHITE, 8);
+}
+
+static void screen_fingerprint(void)
+{
+    LCD_setScreen(WHITE);
+    LCD_drawString(15, 50, "Waiting for Fingerprint", BLUE, WHITE, 8);
+}
+
+static void screen_welcome(void)
+{
+    LCD_setScreen(WHITE);
+    LCD_drawString(20, 50, "Welcome, Yongwoo", BLUE, WHITE, 8);
+}
+
+static void screen_combination(void)
+{
+    LCD_setScreen(WHITE);
+    LCD_drawString(29, 50, "Enter Combination", BLUE, WHITE, 8);
+    draw_combination_progress(0);
+}
+
+static void update_knobs(void) { draw_combination_progress(0x07); }
+
+static void screen_accepted(void)
+{
+    LCD_setScreen(WHITE);
+    LCD_drawString(20, 50, "Combination Accepted", BLUE, WHITE, 8);
+}
+
+static void screen_pin(void)
+{
+    LCD_setScreen(WHITE);
+    LCD_drawString(20, 45, "Enter PIN:", BLUE, WHITE, 8);
+    LCD_drawString(20, 55, "# to finish", BLUE, WHITE, 8);
+    draw_PIN_digits(0);
+}
+
+static void update_digit(void) { draw_PIN_digits(1); }
+
+static void screen_wrong_pin(void)
+{
+    LCD_setScreen(RED);
+    LCD_drawString(41, 60, "Incorrect PIN", WHITE, RED, 8);
+    LCD_drawString(41, 80, "Press * to retry", WHITE, RED, 8);
+}
+
+static void screen_unlocked(void)
+{
+    LCD_setScreen(GREEN);
+    LCD_drawString(44, 60, "PIN accepted", WHITE, GREEN, 8);
+}
+
+static const screen_t screens[] = {
+    {"locked", screen_locked},
+    {"fingerprint", screen_fingerprint},
+    {"welcome", screen_welcome},
+    {"combination", screen_combination},
+    {"knob update", update_knobs},
+    {"combination ok", screen_accepted},
+    {"pin", screen_pin},
+    {"digit update", update_digit},
+    {"wrong pin", screen_wrong_pin},
+    {"unlocked", screen_unlocked},
+};
+
+#define SCREEN_COUNT (sizeof(screens) / sizeof(screens[0]))
+
+// ---------------------------------- SPI dump ---------------------------------------
+static FILE *dump_file;
+static const char *dump_screen;
+
+static void dump_byte(uint8_t data)
+{
+    char dc = (hal_host_latch(LCD_PORT) & (1 << LCD_DC)) ? 'D' : 'C';
+    fprintf(dump_file, "%s,%c,%u\n", dump_screen, dc, data);
+}
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [--csv] [--repeat N] [--dump FILE]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    int csv = 0;
+    int repeat = 100;
+    const char *dump_path = NULL;
+
+    static const struct option options[] = {
+        {"csv", no_argument, NULL, 'c'},
+        {"repeat", required_argument, NULL, 'r'},
+        {"dump", required_argument, NULL, 'd'},
+        {NULL, 0, NULL, 0}};
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "cr:d:", options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'c': csv = 1; break;
+        case 'r': repeat = atoi(optarg); break;
+        case 'd': dump_path = optarg; break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (repeat < 1 || optind != argc)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (dump_path)
+    {
+        dump_file = fopen(dump_path, "w");
+        if (!dump_file)
+        {
+            fprintf(stderr, "[X] can't write %s\n", dump_path);
+            return 1;
+        }
+    }
+
+    hal_host_reset();
+    LCD_init();
+    hal_host_stats_t init = hal_host_stats;
+
+    if (csv)
+        printf("screen,spi_bytes,gpio_edges,delay_ms,spi_ms,native_us\n");
+    else
+        printf("%-16s %10s %10s %10s %10s %10s\n", "screen", "SPI bytes", "GPIO edges", "delay ms", "SPI ms", "native us");
+
+    hal_host_stats_t total = {0};
+    for (size_t i = 0; i < SCREEN_COUNT; i++)
+    {
+        // one recorded pass, then the timed repeats without the dump hook
+        dump_screen = screens[i].name;
+        hal_host_spi_hook = dump_file ? dump_byte : NULL;
+        hal_host_reset();
+        screens[i].draw();
+        hal_host_stats_t stats = hal_host_stats;
+        hal_host_spi_hook = NULL;
+
+        double start = now_us();
+        for (int r = 0; r < repeat; r++)
+            screens[i].draw();
+        double native = (now_us() - start) / repeat;
+
+        double delay_ms = stats.delay_us / 1000.0;
+        double spi_ms = stats.spi_bytes * 8 * 1000.0 / SPI_HZ;
+        if (csv)
+            printf("%s,%u,%u,%.3f,%.3f,%.1f\n", screens[i].name, stats.spi_bytes, stats.gpio_edges, delay_ms, spi_ms, native);
+        else
+            printf("%-16s %10u %10u %10.1f %10.2f %10.1f\n", screens[i].name, stats.spi_bytes, stats.gpio_edges, delay_ms, spi_ms, native);
+
+        total.spi_bytes += stats.spi_bytes;
+        total.gpio_edges += stats.gpio_edges;
+        total.delay_us += stats.delay_us;
+    }
+
+    if (!csv)
+    {
+        printf("%-16s %10u %10u %10.1f %10.2f\n", "total", total.spi_bytes, total.gpio_edges,
+               total.delay_us / 1000.0, total.spi_bytes * 8 * 1000.0 / SPI_HZ);
+        printf("LCD_init: %u SPI bytes, %.0f ms of delays, backlight duty %u/255\n",
+               init.spi_bytes, init.delay_us / 1000.0, init.pwm0a);
+    }
+
+    if (dump_file)
+        fclose(dump_file);
+    return 0;
+}
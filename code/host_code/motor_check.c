@@ -0,0 +1,128 @@
+/*
+ * motor_check.c - native check of the door motor driver (motor.c) on stubbed Timer2 registers
+ *
+ * motor.c and the real scheduler (sched.c) are built against the host avr/io.h and avr/sleep.h; the timebase is
+ * a counter here that moves on 1 ms per sched_run() pass. Each pass records OCR2B, the PWM duty on IN1.
+ *
+ * Plays the door profile from LCD_comms.c (255 duty, 80 ms ramps, 560 ms) and checks that the duty rises from
+ * MOTOR_START_DUTY to 255, holds, ramps back down, and that the callback reports MOTOR_DONE_TIME at 560 ms with
+ * the drive off. Also checks the inverted compare output going down, and that motor_stop() mid-move cuts the
+ * drive without a callback. Exit status is 1 if any check fails.
+ *
+ * Build (from code/host_code):
+ *   gcc -O2 -std=gnu99 -I. -I../c_code ../c_code/motor.c ../c_code/sched.c avr_host.c motor_check.c \
+ *       -o motor_check
+ */
+
+#include <avr/io.h>
+#include "motor.h"
+#include "sched.h"
+
+#include <stdio.h>
+
+#define RUN_MS 700
+
+static const motor_profile_t door_profile = {255, 80, 560, 80};     // as in LCD_comms.c
+
+static uint32_t now_ms;
+static uint8_t duty[RUN_MS];        // OCR2B after each pass
+static int done_reason = -1;
+static uint32_t done_ms;
+static int failures;
+
+uint32_t timebase_ms(void) { return now_ms; }
+uint32_t timebase_us(void) { return now_ms * 1000; }
+
+static void door_done(uint8_t reason)
+{
+    done_reason = reason;
+    done_ms = now_ms;
+}
+
+static void check(int ok, const char *what)
+{
+    printf("%s %s\n", ok ? "[ok]" : "[X] ", what);
+    if (!ok)
+        failures++;
+}
+
+static void run(uint32_t ms, uint32_t start)
+{
+    for (uint32_t i = 0; i < ms; i++) {
+        now_ms++;
+        sched_run();
+        if (now_ms - start < RUN_MS)
+            duty[now_ms - start] = OCR2B;
+    }
+}
+
+static int drive_off(void)
+{
+    return TCCR2B == 0 && TCCR2A == 0 && !(PORTD & ((1 << MOTOR_IN1) | (1 << MOTOR_IN2))) && !motor_busy();
+}
+
+static void check_up(void)
+{
+    uint32_t start = now_ms;
+    uint32_t ramp_done = 0, ramp_down = 0;
+    int rising = 1, falling = 1;
+
+    printf("door up, 255 duty, 80 ms ramps, 560 ms\n");
+    motor_move(MOTOR_UP, &door_profile, door_done);
+    check(TCCR2A == ((1 << WGM21) | (1 << WGM20) | (1 << COM2B1)) && TCCR2B == ((1 << CS21) | (1 << CS20)),
+          "Timer2 fast PWM /32 on OC2B, non-inverting going up");
+    check(OCR2B == MOTOR_START_DUTY, "starts at MOTOR_START_DUTY");
+    duty[0] = OCR2B;
+
+    run(RUN_MS - 1, start);
+
+    for (uint32_t t = 1; t < door_profile.run_ms; t++) {
+        if (!ramp_done) {
+            rising &= duty[t] >= duty[t - 1];
+            if (duty[t] == 255)
+                ramp_done = t;
+        } else if (!ramp_down && duty[t] < 255) {
+            ramp_down = t;
+        } else if (ramp_down) {
+            falling &= duty[t] <= duty[t - 1];
+        }
+    }
+    printf("  duty %u at 0 ms, 255 from %u ms, down from %u ms, %u at %u ms\n", duty[0], ramp_done, ramp_down,
+           duty[door_profile.run_ms - 1], door_profile.run_ms - 1);
+    printf("  callback reason %d at %u ms\n", done_reason, done_ms - start);
+
+    check(rising && ramp_done >= 75 && ramp_done <= 85, "ramps up to 255 over 80 ms");
+    check(ramp_down >= 475 && ramp_down <= 485, "holds 255 until the last 80 ms");
+    check(falling && duty[door_profile.run_ms - 1] < 255, "ramps back down");
+    check(done_reason == MOTOR_DONE_TIME && done_ms - start >= 560 && done_ms - start < 560 + MOTOR_TICK_MS,
+          "callback with MOTOR_DONE_TIME at 560 ms");
+    check(drive_off(), "drive off afterwards");
+}
+
+static void check_down_and_stop(void)
+{
+    printf("door down, stopped after 100 ms\n");
+    done_reason = -1;
+    motor_move(MOTOR_DOWN, &door_profile, door_done);
+    check((TCCR2A & (1 << COM2B0)) && (PORTD & (1 << MOTOR_IN2)), "going down: IN2 high, compare output inverted");
+
+    run(100, now_ms);
+    motor_stop();
+    run(600, now_ms);
+    check(done_reason == -1, "motor_stop() drops the callback");
+    check(drive_off(), "motor_stop() cuts the drive");
+}
+
+int main(void)
+{
+    sched_init();
+    motor_init();
+    check((DDRD & ((1 << MOTOR_IN1) | (1 << MOTOR_IN2))) == ((1 << MOTOR_IN1) | (1 << MOTOR_IN2)) && drive_off(),
+          "IN1/IN2 outputs, coasting");
+
+    check_up();
+    check_down_and_stop();
+
+    printf("%d failed\n", failures);
+    return failures ? 1 : 0;
+}
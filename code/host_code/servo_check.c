@@ -0,0 +1,81 @@
+/*
+ * servo_check.c - native check of the latch servo driver (servo.c) on stubbed Timer4 registers
+ *
+ * servo.c is built against the host avr/io.h, so Timer4 is a set of plain variables. The check reads the setup
+ * back from them and plays the 20 ms frames by calling the Timer4 overflow ISR while its interrupt is enabled,
+ * recording OCR4B after each one. OCR4B counts 0.5 us.
+ *
+ * Checks the fast PWM setup (mode 14, TOP 39999, /8), the 1000-2000 us clamp, that 0 -> 120 degrees over
+ * 600 ms reaches 1800 us in 30 frames without overshooting, that 120 -> 0 stops at the 1000 us clamp, and that
+ * a move of 0 ms jumps at once. Exit status is 1 if any check fails.
+ *
+ * Build (from code/host_code):
+ *   gcc -O2 -std=gnu99 -I. -I../c_code ../c_code/servo.c avr_host.c servo_check.c -o servo_check
+ */
+
+#include <avr/io.h>
+#include "servo.h"
+
+#include <stdio.h>
+
+#define MAX_FRAMES 1000
+#define US(counts) ((counts) / 2)
+
+void TIMER4_OVF_vect(void);
+
+static int failures;
+
+static void check(int ok, const char *what)
+{
+    printf("%s %s\n", ok ? "[ok]" : "[X] ", what);
+    if (!ok)
+        failures++;
+}
+
+// plays frames until the ramp switches its interrupt off; returns how many it took, 0 if the pulse ever moved
+// away from the target
+static int ramp(uint16_t from, uint16_t to)
+{
+    int frames = 0;
+    uint16_t last = from;
+
+    while (servo_busy() && frames < MAX_FRAMES) {
+        TIMER4_OVF_vect();
+        frames++;
+        if ((to > from && (OCR4B < last || OCR4B > to)) || (to < from && (OCR4B > last || OCR4B < to)))
+            return 0;
+        last = OCR4B;
+    }
+    printf("  %u -> %u us in %d frames (%d ms)\n", US(from), US(OCR4B), frames, frames * 20);
+    return frames;
+}
+
+int main(void)
+{
+    const uint8_t mode_a = (1 << COM4B1) | (1 << WGM41);
+    const uint8_t mode_b = (1 << WGM43) | (1 << WGM42) | (1 << CS41);
+    int frames;
+
+    servo_init();
+    check(ICR4 == 39999 && TCCR4A == mode_a && TCCR4B == mode_b, "Timer4 fast PWM, TOP 39999, /8, OC4B non-inverting");
+    check(DDRD & (1 << SERVO_PIN), "PD2 is an output");
+    check(US(OCR4B) == 1500 && !servo_busy(), "starts centred at 1500 us");
+
+    servo_write_deg(0);
+    check(US(OCR4B) == 1000 && !servo_busy(), "0 degrees jumps to the 1000 us clamp");
+
+    servo_move_deg(120, 600);
+    check(servo_busy(), "a move turns the overflow interrupt on");
+    frames = ramp(2000, 3600);
+    check(frames == 30 && US(OCR4B) == 1800, "0 -> 120 degrees reaches 1800 us in 30 frames, no overshoot");
+
+    servo_move_deg(0, 600);
+    frames = ramp(3600, 2000);
+    check(frames > 0 && frames <= 30 && US(OCR4B) == 1000, "120 -> 0 degrees stops at the 1000 us clamp");
+
+    servo_move_us(2500, 0);
+    check(US(OCR4B) == 2000 && !servo_busy(), "a 0 ms move jumps, clamped to 2000 us");
+
+    printf("%d failed\n", failures);
+    return failures ? 1 : 0;
+}
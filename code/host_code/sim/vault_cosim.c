@@ -0,0 +1,414 @@
+/*
+ * vault_cosim.c - simavr co-simulation of both ATmega firmwares
+ *
+ * Runs the LCD/actuator firmware (LCD_comms.c) and the keypad/ADC firmware (ADC_confirm_identity.c) side by
+ * side in simavr, kept within one cycle-run of each other, and wires them together the way the box is wired:
+ *
+ *   - TWI0 (PC4/PC5): message link, each MCU's TWI output IRQ feeds the other's input
+ *   - PC3 -> PC3: trace sync line
+ *
+ * Everything else is stubbed:
+ *   - ESP32: identity frames (vault_link.h format) injected into the LCD MCU's USART0 RX; PC0 (reset line) logged
+ *   - keypad matrix: rows PB1/PD2/PD3/PD4 are watched, the pressed key's column (PD5/PD6/PD7/PB0) follows its row
+ *   - knobs and switches: ADC0-2 voltages and PB2-PB4 levels on the keypad MCU
+ *   - LCD: SPI0 output bytes counted; a screen update is over once SPI has been quiet for the step's window
+ *
+ * A scripted unlock (fingerprint, combination, PIN, lock) is played once. Each step reports the latency from
+ * the stimulus to the last SPI byte of the screen it caused, the SPI bytes sent, and the fraction of cycles each
+ * MCU was awake (not in SLEEP) during the step. Exit status is 1 if any step times out, so CI can gate on it.
+ *
+ * simavr does not model TWI arbitration, so the rare case of both MCUs starting a frame together isn't exercised.
+ *
+ * Build (needs a simavr build with the atmega328pb core, and libelf):
+ *   gcc -O2 -std=gnu99 vault_cosim.c -lsimavr -lelf -o vault_cosim
+ * Firmware images (from code/c_code):
+ *   avr-gcc -mmcu=atmega328pb -Os -DF_CPU=16000000UL LCD_comms.c ST7735_new.c LCD_GFX_new.c vault_link.c \
+ *       mcu_link.c timebase.c trace.c vault_fsm.c sched.c servo.c motor.c power.c -lm -o lcd.elf
+ *   avr-gcc -mmcu=atmega328pb -Os -DF_CPU=16000000UL ADC_confirm_identity.c adc.c knob.c keypad.c uart.c mcu_link.c \
+ *       timebase.c trace.c vault_fsm.c sched.c telemetry.c power.c -o keypad.elf
+ *
+ * Usage: vault_cosim [--identity N] [--pin DDDD] [--csv] [--trace-dir DIR] lcd.elf keypad.elf
+ *   --identity N     R503 template ID the stub ESP32 reports (default 0 = Yongwoo)
+ *   --pin DDDD       PIN typed on the keypad (default 1234)
+ *   --csv            print the results as CSV instead of a table
+ *   --trace-dir DIR  write each MCU's USART0 output to DIR/lcd.log and DIR/keypad.log (for trace_merge,
+ *                    telemetry_decode)
+ */
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/sim_io.h>
+#include <simavr/avr_ioport.h>
+#include <simavr/avr_uart.h>
+#include <simavr/avr_spi.h>
+#include <simavr/avr_adc.h>
+#include <simavr/avr_twi.h>
+
+#define F_CPU 16000000UL
+#define MS(x) ((avr_cycle_count_t)(x) * (F_CPU / 1000))
+#define STEP_TIMEOUT MS(15000)
+#define THINK_TIME MS(50)          // idle time between one step finishing and the next stimulus
+#define KEY_HOLD MS(150)
+
+// combination on the keypad MCU (password_init() targets, ADC counts and switch levels)
+static const uint16_t knob_targets[3] = {512, 768, 256};
+static const uint8_t switch_targets[3] = {0, 1, 0};
+
+// ------------------------------------ MCUs --------------------------------------
+
+typedef struct {
+    const char *name;
+    avr_t *avr;
+    avr_cycle_count_t awake;    // cycles spent running (busy-waits included)
+    avr_cycle_count_t asleep;
+    FILE *log;                  // USART0 output capture, optional
+} mcu_t;
+
+static mcu_t lcd = {"lcd"};
+static mcu_t keypad = {"keypad"};
+
+static void load_mcu(mcu_t *mcu, const char *path)
+{
+    elf_firmware_t fw;
+    memset(&fw, 0, sizeof(fw));
+
+    if (elf_read_firmware(path, &fw) != 0) {
+        fprintf(stderr, "[X] can't read %s\n", path);
+        exit(2);
+    }
+
+    mcu->avr = avr_make_mcu_by_name(fw.mmcu[0] ? fw.mmcu : "atmega328pb");
+    if (!mcu->avr) {
+        fprintf(stderr, "[X] %s: simavr has no core for %s\n", path, fw.mmcu);
+        exit(2);
+    }
+
+    avr_init(mcu->avr);
+    avr_load_firmware(mcu->avr, &fw);
+    mcu->avr->frequency = F_CPU;
+    mcu->avr->avcc = 5000;
+    mcu->avr->aref = 5000;
+
+    // keep USART0 output away from our stdout
+    uint32_t flags = 0;
+    avr_ioctl(mcu->avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+    flags &= ~AVR_UART_FLAG_STDIO;
+    avr_ioctl(mcu->avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+}
+
+static avr_irq_t *pin_irq(mcu_t *mcu, char port, int pin)
+{
+    return avr_io_getirq(mcu->avr, AVR_IOCTL_IOPORT_GETIRQ(port), pin);
+}
+
+// runs whichever MCU is behind, so neither gets more than one avr_run() ahead of the other
+static avr_cycle_count_t step_mcus(void)
+{
+    mcu_t *mcu = (lcd.avr->cycle <= keypad.avr->cycle) ? &lcd : &keypad;
+    avr_cycle_count_t before = mcu->avr->cycle;
+    int sleeping = mcu->avr->state == cpu_Sleeping;
+
+    int state = avr_run(mcu->avr);
+    if (state == cpu_Done || state == cpu_Crashed) {
+        fprintf(stderr, "[X] %s firmware stopped (state %d) at cycle %llu\n", mcu->name, state,
+                (unsigned long long)mcu->avr->cycle);
+        exit(1);
+    }
+
+    if (sleeping)
+        mcu->asleep += mcu->avr->cycle - before;
+    else
+        mcu->awake += mcu->avr->cycle - before;
+
+    return lcd.avr->cycle < keypad.avr->cycle ? lcd.avr->cycle : keypad.avr->cycle;
+}
+
+// ------------------------------------ stubs --------------------------------------
+
+static avr_cycle_count_t spi_last = 0;      // cycle of the last SPI byte to the LCD
+static uint32_t spi_bytes = 0;
+
+static void spi_out_hook(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    spi_last = lcd.avr->cycle;
+    spi_bytes++;
+}
+
+static void uart_out_hook(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    mcu_t *mcu = param;
+    if (mcu->log)
+        fputc((int)value, mcu->log);
+}
+
+static void reset_line_hook(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    fprintf(stderr, "  reset line %s at %.3f ms\n", value ? "high" : "low", lcd.avr->cycle * 1000.0 / F_CPU);
+}
+
+// ESP32: one vault_link frame, CRC-8/CCITT over seq..confidence
+static uint8_t esp_seq = 0;
+
+static uint8_t crc8_ccitt(uint8_t crc, uint8_t data)
+{
+    crc ^= data;
+    for (int i = 0; i < 8; i++)
+        crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+    return crc;
+}
+
+static void esp_send_identity(uint16_t id)
+{
+    uint8_t frame[8] = {0xA5, esp_seq++, 1, id & 0xFF, id >> 8, 200, 0, 0};
+    for (int i = 1; i < 7; i++)
+        frame[7] = crc8_ccitt(frame[7], frame[i]);
+
+    avr_irq_t *rx = avr_io_getirq(lcd.avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_INPUT);
+    for (int i = 0; i < 8; i++)
+        avr_raise_irq(rx, frame[i]);
+}
+
+// keypad matrix: rows PB1, PD2, PD3, PD4 (driven), columns PD5, PD6, PD7, PB0 (read, pulled up)
+static const struct { char port; int pin; } rows[4] = {{'B', 1}, {'D', 2}, {'D', 3}, {'D', 4}};
+static const struct { char port; int pin; } cols[4] = {{'D', 5}, {'D', 6}, {'D', 7}, {'B', 0}};
+static const char keymap[4][4] = {{'1', '2', '3', 'A'}, {'4', '5', '6', 'B'}, {'7', '8', '9', 'C'}, {'*', '0', '#', 'D'}};
+
+static uint8_t row_level[4] = {1, 1, 1, 1};
+static int pressed_row = -1, pressed_col = -1;
+
+static void update_columns(void)
+{
+    for (int c = 0; c < 4; c++) {
+        int low = (c == pressed_col && row_level[pressed_row] == 0);
+        avr_raise_irq(pin_irq(&keypad, cols[c].port, cols[c].pin), !low);
+    }
+}
+
+static void row_hook(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    row_level[(intptr_t)param] = value;
+    if (pressed_row >= 0)
+        update_columns();
+}
+
+static void press_key(char key)
+{
+    pressed_row = pressed_col = -1;
+    for (int r = 0; r < 4; r++)
+        for (int c = 0; c < 4; c++)
+            if (keymap[r][c] == key) {
+                pressed_row = r;
+                pressed_col = c;
+            }
+    update_columns();
+}
+
+static void release_key(void)
+{
+    pressed_row = pressed_col = -1;
+    update_columns();
+}
+
+// knobs: ADC counts -> millivolts on ADC0-2; switches on PB2-PB4
+static void set_controls(const uint16_t knobs[3], const uint8_t switches[3])
+{
+    for (int i = 0; i < 3; i++) {
+        avr_raise_irq(avr_io_getirq(keypad.avr, AVR_IOCTL_ADC_GETIRQ, ADC_IRQ_ADC0 + i),
+                      (uint32_t)knobs[i] * 5000 / 1024);
+        avr_raise_irq(pin_irq(&keypad, 'B', 2 + i), switches[i]);
+    }
+}
+
+static void wire_up(void)
+{
+    // TWI0 message link, both directions
+    avr_connect_irq(avr_io_getirq(lcd.avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_OUTPUT),
+                    avr_io_getirq(keypad.avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_INPUT));
+    avr_connect_irq(avr_io_getirq(keypad.avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_OUTPUT),
+                    avr_io_getirq(lcd.avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_INPUT));
+
+    // trace sync line
+    avr_connect_irq(pin_irq(&lcd, 'C', 3), pin_irq(&keypad, 'C', 3));
+
+    avr_irq_register_notify(avr_io_getirq(lcd.avr, AVR_IOCTL_SPI_GETIRQ(0), SPI_IRQ_OUTPUT), spi_out_hook, NULL);
+    avr_irq_register_notify(pin_irq(&lcd, 'C', 0), reset_line_hook, NULL);
+    avr_irq_register_notify(avr_io_getirq(lcd.avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT), uart_out_hook, &lcd);
+    avr_irq_register_notify(avr_io_getirq(keypad.avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT), uart_out_hook, &keypad);
+
+    for (intptr_t r = 0; r < 4; r++)
+        avr_irq_register_notify(pin_irq(&keypad, rows[r].port, rows[r].pin), row_hook, (void *)r);
+
+    // idle inputs: no key, every control away from its target
+    static const uint16_t knobs_off[3] = {0, 0, 0};
+    static const uint8_t switches_off[3] = {1, 0, 1};
+    release_key();
+    set_controls(knobs_off, switches_off);
+}
+
+// ------------------------------------ script --------------------------------------
+
+typedef enum { ACT_BOOT, ACT_IDENTITY, ACT_COMBINATION, ACT_KEY } action_t;
+
+typedef struct {
+    const char *name;
+    action_t action;
+    char key;
+    uint16_t quiet_ms;      // SPI silence that ends the step; longer than any fixed delay inside the screen change
+} step_t;
+
+typedef struct {
+    double latency_ms;
+    uint32_t spi_bytes;
+    double lcd_awake, keypad_awake;
+} result_t;
+
+static int run_step(const step_t *step, uint16_t identity, result_t *result)
+{
+    avr_cycle_count_t now = step_mcus();
+    avr_cycle_count_t start = now;
+    avr_cycle_count_t lcd_awake = lcd.awake, lcd_asleep = lcd.asleep;
+    avr_cycle_count_t kp_awake = keypad.awake, kp_asleep = keypad.asleep;
+    uint32_t bytes = spi_bytes;
+    avr_cycle_count_t release_at = 0;
+
+    switch (step->action) {
+    case ACT_BOOT:
+        break;
+    case ACT_IDENTITY:
+        esp_send_identity(identity);
+        break;
+    case ACT_COMBINATION:
+        set_controls(knob_targets, switch_targets);
+        break;
+    case ACT_KEY:
+        press_key(step->key);
+        release_at = start + KEY_HOLD;
+        break;
+    }
+
+    while (1) {
+        now = step_mcus();
+
+        if (release_at && now >= release_at) {
+            release_key();
+            release_at = 0;
+        }
+
+        if (spi_bytes != bytes && spi_last >= start && now - spi_last >= MS(step->quiet_ms) && !release_at)
+            break;
+
+        if (now - start > STEP_TIMEOUT)
+            return 0;
+    }
+
+    avr_cycle_count_t lcd_total = (lcd.awake - lcd_awake) + (lcd.asleep - lcd_asleep);
+    avr_cycle_count_t kp_total = (keypad.awake - kp_awake) + (keypad.asleep - kp_asleep);
+
+    result->latency_ms = (spi_last - start) * 1000.0 / F_CPU;
+    result->spi_bytes = spi_bytes - bytes;
+    result->lcd_awake = lcd_total ? (double)(lcd.awake - lcd_awake) / lcd_total : 0;
+    result->keypad_awake = kp_total ? (double)(keypad.awake - kp_awake) / kp_total : 0;
+
+    // let both sides settle before the next stimulus
+    avr_cycle_count_t resume = now + THINK_TIME;
+    while (step_mcus() < resume);
+    return 1;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [--identity N] [--pin DDDD] [--csv] [--trace-dir DIR] lcd.elf keypad.elf\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    uint16_t identity = 0;
+    const char *pin = "1234";
+    const char *trace_dir = NULL;
+    int csv = 0;
+
+    static const struct option options[] = {
+        {"identity", required_argument, NULL, 'i'},
+        {"pin", required_argument, NULL, 'p'},
+        {"csv", no_argument, NULL, 'c'},
+        {"trace-dir", required_argument, NULL, 't'},
+        {NULL, 0, NULL, 0}};
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "i:p:ct:", options, NULL)) != -1) {
+        switch (opt) {
+        case 'i': identity = atoi(optarg); break;
+        case 'p': pin = optarg; break;
+        case 'c': csv = 1; break;
+        case 't': trace_dir = optarg; break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (argc - optind != 2 || strlen(pin) != 4) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    load_mcu(&lcd, argv[optind]);
+    load_mcu(&keypad, argv[optind + 1]);
+
+    if (trace_dir) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/lcd.log", trace_dir);
+        lcd.log = fopen(path, "w");
+        snprintf(path, sizeof(path), "%s/keypad.log", trace_dir);
+        keypad.log = fopen(path, "w");
+    }
+
+    wire_up();
+
+    step_t steps[] = {
+        {"boot", ACT_BOOT, 0, 2000},                    // System Locked, latch + door delays, fingerprint screen
+        {"fingerprint", ACT_IDENTITY, 0, 700},          // greeting, door opens, combination screen
+        {"combination", ACT_COMBINATION, 0, 1200},      // Combination Accepted held 1 s, PIN screen
+        {"digit 1", ACT_KEY, pin[0], 100},
+        {"digit 2", ACT_KEY, pin[1], 100},
+        {"digit 3", ACT_KEY, pin[2], 100},
+        {"digit 4", ACT_KEY, pin[3], 100},
+        {"enter", ACT_KEY, '#', 1200},                  // PIN accepted, latch opens, UNLOCKED screen
+        {"lock", ACT_KEY, '*', 2000},                   // LOCKING, reset pulse, lockdown, fingerprint screen
+    };
+    int count = sizeof(steps) / sizeof(steps[0]);
+    int failed = 0;
+
+    if (csv)
+        printf("step,latency_ms,spi_bytes,lcd_awake,keypad_awake\n");
+    else
+        printf("%-12s %12s %10s %10s %10s\n", "step", "latency ms", "SPI bytes", "LCD awake", "keypad awake");
+
+    for (int i = 0; i < count; i++) {
+        result_t r;
+        if (!run_step(&steps[i], identity, &r)) {
+            fprintf(stderr, "[X] step '%s' timed out\n", steps[i].name);
+            failed = 1;
+            break;
+        }
+
+        if (csv)
+            printf("%s,%.3f,%u,%.3f,%.3f\n", steps[i].name, r.latency_ms, r.spi_bytes, r.lcd_awake, r.keypad_awake);
+        else
+            printf("%-12s %12.3f %10u %9.1f%% %9.1f%%\n", steps[i].name, r.latency_ms, r.spi_bytes,
+                   r.lcd_awake * 100, r.keypad_awake * 100);
+    }
+
+    if (lcd.log)
+        fclose(lcd.log);
+    if (keypad.log)
+        fclose(keypad.log);
+
+    return failed;
+}
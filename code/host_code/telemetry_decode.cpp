@@ -0,0 +1,336 @@
+/**
+ * @file telemetry_decode.cpp
+ * @brief Decodes the keypad MCU's binary telemetry stream into a readable log or CSV.
+ *
+ * Reads a raw USART0 capture (a serial port dumped to a file, or vault_cosim --trace-dir keypad.log) made of
+ * COBS frames ending in 0x00, as written by c_code/telemetry.c. Each frame is checked against its CRC-16/XMODEM;
+ * anything that isn't a valid frame (console replies, trace dumps, the boot banner) is passed through as text
+ * in log mode and dropped from the CSV. Gaps in the record sequence number, which is what the TX ring drops
+ * look like from here, and CRC failures are reported on stderr.
+ *
+ * Usage: telemetry_decode [--csv] [--output FILE] [capture]
+ *   --csv            one row per record instead of the log (time_ms,seq,record,adc0,...,dwell_ms)
+ *   --output FILE    write to FILE (default stdout)
+ *   capture          raw capture file (default stdin)
+ *
+ * Build: g++ -O2 -std=c++17 telemetry_decode.cpp -o telemetry_decode
+ */
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// keep in step with c_code/telemetry.h
+#define TELEM_ADC 1
+#define TELEM_KEY 2
+#define TELEM_STATE 3
+#define TELEM_LINK 4
+#define TELEM_ZONE 5
+#define TELEM_KEY_DIGIT 0xFF
+
+#define TELEM_HEADER 6
+
+struct Counts
+{
+    size_t records = 0;
+    size_t crcErrors = 0;
+    size_t lost = 0;
+    int lastSeq = -1;
+};
+
+// keep in step with c_code/vault_fsm.h
+static const char *stateName(unsigned state)
+{
+    switch (state)
+    {
+    case 0: return "LOCKED";
+    case 1: return "COMBINATION";
+    case 2: return "PIN";
+    case 3: return "WRONG_PIN";
+    case 4: return "UNLOCKED";
+    default: return "?";
+    }
+}
+
+static const char *eventName(unsigned event)
+{
+    switch (event)
+    {
+    case 0: return "identity";
+    case 1: return "combination ok";
+    case 2: return "combination lost";
+    case 3: return "PIN ok";
+    case 4: return "PIN wrong";
+    case 5: return "lock";
+    case 6: return "timeout";
+    default: return "?";
+    }
+}
+
+// keep in step with c_code/mcu_link.h
+static const char *messageName(unsigned type)
+{
+    switch (type)
+    {
+    case 1: return "IDENTITY";
+    case 2: return "STAGE";
+    case 3: return "DIGITS";
+    case 4: return "KNOBS";
+    case 6: return "ACK";
+    default: return "?";
+    }
+}
+
+// key codes: KEYPAD_KEY_* and KEYPAD_KEYMAP in c_code/keypad.h, keep this table in step with them
+static std::string keyName(unsigned key)
+{
+    switch (key)
+    {
+    case TELEM_KEY_DIGIT: return "digit";
+    case 10: return "A";
+    case 11: return "B";
+    case 12: return "C";
+    case 13: return "D";
+    case 14: return "*";
+    case 15: return "#";
+    default: return std::to_string(key);
+    }
+}
+
+static uint16_t crcXmodem(const uint8_t *data, size_t length)
+{
+    uint16_t crc = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        crc ^= uint16_t(data[i]) << 8;
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc & 0x8000) ? uint16_t((crc << 1) ^ 0x1021) : uint16_t(crc << 1);
+    }
+    return crc;
+}
+
+static bool cobsDecode(const uint8_t *data, size_t length, std::vector<uint8_t> &out)
+{
+    out.clear();
+    size_t i = 0;
+    while (i < length)
+    {
+        uint8_t code = data[i++];
+        if (code == 0 || i + code - 1 > length)
+            return false;
+        out.insert(out.end(), data + i, data + i + code - 1);
+        i += code - 1;
+        if (i < length)
+            out.push_back(0);
+    }
+    return true;
+}
+
+static size_t payloadLength(unsigned type)
+{
+    switch (type)
+    {
+    case TELEM_ADC: return 7;
+    case TELEM_KEY: return 2;
+    case TELEM_STATE: return 4;
+    case TELEM_LINK: return 2;
+    case TELEM_ZONE: return 4;
+    default: return SIZE_MAX;
+    }
+}
+
+// a decoded record with a known type, the right length and a good CRC
+static bool validRecord(const std::vector<uint8_t> &record)
+{
+    if (record.size() < TELEM_HEADER + 2 || payloadLength(record[0]) != record.size() - TELEM_HEADER - 2)
+        return false;
+    size_t n = record.size() - 2;
+    return crcXmodem(record.data(), n) == uint16_t(record[n] | record[n + 1] << 8);
+}
+
+static void printRecord(FILE *out, const std::vector<uint8_t> &r, bool csv)
+{
+    unsigned long time = r[2] | r[3] << 8 | r[4] << 16 | (unsigned long)r[5] << 24;
+    const uint8_t *p = r.data() + TELEM_HEADER;
+
+    if (csv)
+    {
+        // time_ms,seq,record,adc0,adc1,adc2,switches,key,digits,from,event,to,arg,msg_type,msg_arg,knob,zone,dwell_ms
+        fprintf(out, "%lu,%u,", time, r[1]);
+        switch (r[0])
+        {
+        case TELEM_ADC:
+            fprintf(out, "adc,%u,%u,%u,%u,,,,,,,,,,,\n", p[0] | p[1] << 8, p[2] | p[3] << 8, p[4] | p[5] << 8, p[6]);
+            break;
+        case TELEM_KEY:
+            fprintf(out, "key,,,,,%s,%u,,,,,,,,,\n", keyName(p[0]).c_str(), p[1]);
+            break;
+        case TELEM_STATE:
+            fprintf(out, "state,,,,,,,%s,%s,%s,%u,,,,,\n", stateName(p[0]), eventName(p[1]), stateName(p[2]), p[3]);
+            break;
+        case TELEM_LINK:
+            fprintf(out, "link,,,,,,,,,,,%s,%u,,,\n", messageName(p[0]), p[1]);
+            break;
+        case TELEM_ZONE:
+            fprintf(out, "zone,,,,,,,,,,,,,%u,%s,%u\n", p[0], p[1] ? "entered" : "left", p[2] | p[3] << 8);
+            break;
+        }
+        return;
+    }
+
+    fprintf(out, "%10.3f  #%-3u ", time / 1000.0, r[1]);
+    switch (r[0])
+    {
+    case TELEM_ADC:
+        fprintf(out, "adc    %4u %4u %4u  switches %u%u%u\n", p[0] | p[1] << 8, p[2] | p[3] << 8, p[4] | p[5] << 8,
+                p[6] & 1, (p[6] >> 1) & 1, (p[6] >> 2) & 1);
+        break;
+    case TELEM_KEY:
+        fprintf(out, "key    %s (%u PIN digits)\n", keyName(p[0]).c_str(), p[1]);
+        break;
+    case TELEM_STATE:
+        fprintf(out, "state  %s --%s--> %s (arg %u)\n", stateName(p[0]), eventName(p[1]), stateName(p[2]), p[3]);
+        break;
+    case TELEM_LINK:
+        fprintf(out, "link   %s %u\n", messageName(p[0]), p[1]);
+        break;
+    case TELEM_ZONE:
+        fprintf(out, "knob   ADC%u %s its zone after %u ms\n", p[0], p[1] ? "entered" : "left", p[2] | p[3] << 8);
+        break;
+    }
+}
+
+static void countRecord(const std::vector<uint8_t> &record, Counts &counts)
+{
+    if (counts.lastSeq >= 0)
+    {
+        unsigned gap = (record[1] - counts.lastSeq - 1) & 0xFF;
+        if (gap)
+        {
+            unsigned long time = record[2] | record[3] << 8 | record[4] << 16 | (unsigned long)record[5] << 24;
+            fprintf(stderr, "[!] %u records lost before %lu ms\n", gap, time);
+            counts.lost += gap;
+        }
+    }
+    counts.lastSeq = record[1];
+    counts.records++;
+}
+
+static void printText(FILE *out, const uint8_t *data, size_t length, bool csv)
+{
+    if (csv)
+        return;
+    for (size_t i = 0; i < length; i++)
+        if (data[i] != '\r')
+            fputc(data[i], out);
+}
+
+// one chunk between 0x00 terminators: a whole frame, or text followed by a frame (the frame starts after the
+// text's last '\n', or sooner if the text had no line ending), or only text
+static void decodeChunk(FILE *out, const std::vector<uint8_t> &chunk, bool csv, Counts &counts)
+{
+    std::vector<uint8_t> record;
+
+    for (size_t start = 0; start < chunk.size(); start++)
+    {
+        if (start > 0 && chunk[start - 1] != '\n')
+            continue;
+        if (cobsDecode(chunk.data() + start, chunk.size() - start, record) && validRecord(record))
+        {
+            printText(out, chunk.data(), start, csv);
+            countRecord(record, counts);
+            printRecord(out, record, csv);
+            return;
+        }
+    }
+
+    // looks like a record that was corrupted on the wire rather than text
+    if (chunk.size() >= TELEM_HEADER + 3 && chunk.size() <= 20 && !memchr(chunk.data(), '\n', chunk.size()))
+    {
+        counts.crcErrors++;
+        fprintf(stderr, "[X] bad frame (%zu bytes) after record #%d\n", chunk.size(), counts.lastSeq);
+        return;
+    }
+    printText(out, chunk.data(), chunk.size(), csv);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [--csv] [--output FILE] [capture]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    bool csv = false;
+    const char *outputPath = NULL;
+
+    static const struct option options[] = {
+        {"csv", no_argument, NULL, 'c'},
+        {"output", required_argument, NULL, 'o'},
+        {NULL, 0, NULL, 0}};
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "co:", options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'c': csv = true; break;
+        case 'o': outputPath = optarg; break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (argc - optind > 1)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    FILE *in = optind < argc ? fopen(argv[optind], "rb") : stdin;
+    if (!in)
+    {
+        fprintf(stderr, "[X] can't read %s\n", argv[optind]);
+        return 1;
+    }
+
+    FILE *out = outputPath ? fopen(outputPath, "w") : stdout;
+    if (!out)
+    {
+        fprintf(stderr, "[X] can't write %s\n", outputPath);
+        return 1;
+    }
+
+    if (csv)
+        fprintf(out, "time_ms,seq,record,adc0,adc1,adc2,switches,key,digits,from,event,to,arg,msg_type,msg_arg,"
+                     "knob,zone,dwell_ms\n");
+
+    Counts counts;
+    std::vector<uint8_t> chunk;
+    int c;
+    while ((c = fgetc(in)) != EOF)
+    {
+        if (c != 0)
+        {
+            chunk.push_back(uint8_t(c));
+            continue;
+        }
+        decodeChunk(out, chunk, csv, counts);
+        chunk.clear();
+    }
+    // trailing text, or a frame cut off by the end of the capture
+    printText(out, chunk.data(), chunk.size(), csv);
+
+    if (in != stdin)
+        fclose(in);
+    if (out != stdout)
+        fclose(out);
+
+    fprintf(stderr, "%zu records, %zu lost, %zu bad frames\n", counts.records, counts.lost, counts.crcErrors);
+    return 0;
+}
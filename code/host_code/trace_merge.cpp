@@ -0,0 +1,260 @@
+/**
+ * @file trace_merge.cpp
+ * @brief Merges the per-MCU unlock trace dumps into one Chrome trace.
+ *
+ * Reads serial captures from the ESP32 and both ATmegas, keeps the "TRACE,<mcu>,<time us>,<event>,<arg>" lines
+ * (everything else in the capture is ignored), maps every clock onto the reference MCU's clock and writes a
+ * trace that chrome://tracing or ui.perfetto.dev can open. Each event becomes a slice lasting until the next
+ * event on the same MCU, so the gaps where the seconds go show up as long bars.
+ *
+ * Clock alignment: every MCU records event 0 (sync) on the same reset line edge. Sync events are paired from
+ * the end of each capture, so an MCU that booted late or was captured late only loses its oldest pairs.
+ * One pair gives an offset; two or more give a piecewise linear map that also takes out crystal drift.
+ *
+ * Usage: trace_merge [--reference NAME] [--output FILE] capture...
+ *   --reference NAME   MCU whose clock the others are mapped onto (default lcd, the one driving the pulse)
+ *   --output FILE      trace JSON (default stdout)
+ *
+ * Build: g++ -O2 -std=c++17 trace_merge.cpp -o trace_merge
+ */
+
+#include <algorithm>
+#include <getopt.h>
+#include <map>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#define TRACE_SYNC 0
+
+struct TraceEvent
+{
+    int64_t time;       // microseconds, own clock until aligned
+    unsigned event;
+    unsigned arg;
+};
+
+struct TraceStream
+{
+    std::vector<TraceEvent> events;
+    int64_t wrap = 0;   // added to raw times once the 32-bit ATmega clock wrapped
+    int64_t last = -1;
+};
+
+// keep in step with c_code/trace.h and c++_code/VaultTrace.h
+static const char *eventName(unsigned event)
+{
+    switch (event)
+    {
+    case 0x00: return "sync";
+    case 0x01: return "overflow";
+    case 0x10: return "finger down";
+    case 0x11: return "features extracted";
+    case 0x12: return "library searched";
+    case 0x13: return "link frame sent";
+    case 0x14: return "finger lifted";
+    case 0x15: return "light sleep";
+    case 0x16: return "woken";
+    case 0x20: return "identity received";
+    case 0x21: return "door open";
+    case 0x22: return "message received";
+    case 0x23: return "screen drawn";
+    case 0x24: return "latch open";
+    case 0x25: return "lock received";
+    case 0x26: return "locked";
+    case 0x30: return "identity received";
+    case 0x31: return "ack received";
+    case 0x32: return "combination accepted";
+    case 0x33: return "digit entered";
+    case 0x34: return "PIN checked";
+    case 0x35: return "lock pressed";
+    default: return "unknown";
+    }
+}
+
+static bool readCapture(const char *path, std::map<std::string, TraceStream> &streams)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+        return false;
+
+    char line[256];
+    while (fgets(line, sizeof(line), file))
+    {
+        char mcu[32];
+        long long time;
+        unsigned event, arg;
+
+        const char *start = strstr(line, "TRACE,");
+        if (!start || sscanf(start, "TRACE,%31[^,],%lld,%u,%u", mcu, &time, &event, &arg) != 4)
+            continue;
+
+        TraceStream &stream = streams[mcu];
+        // timebase_us() on the ATmegas wraps every 71.6 minutes
+        if (stream.last >= 0 && time < stream.last && stream.last - time > (1LL << 31))
+            stream.wrap += 1LL << 32;
+        stream.last = time;
+        stream.events.push_back({time + stream.wrap, event, arg});
+    }
+
+    fclose(file);
+    return true;
+}
+
+static std::vector<int64_t> syncTimes(const TraceStream &stream)
+{
+    std::vector<int64_t> times;
+    for (const TraceEvent &ev : stream.events)
+        if (ev.event == TRACE_SYNC)
+            times.push_back(ev.time);
+    return times;
+}
+
+// maps a time on the stream's clock onto the reference clock through the sync pairs (first = own, second = reference)
+static int64_t alignTime(int64_t t, const std::vector<std::pair<int64_t, int64_t>> &pairs)
+{
+    if (pairs.empty())
+        return t;
+    if (pairs.size() == 1)
+        return t + pairs[0].second - pairs[0].first;
+
+    // segment containing t, or the nearest one at either end
+    size_t i = 1;
+    while (i < pairs.size() - 1 && t > pairs[i].first)
+        i++;
+
+    const auto &a = pairs[i - 1];
+    const auto &b = pairs[i];
+    double rate = double(b.second - a.second) / double(b.first - a.first);
+    return a.second + int64_t(double(t - a.first) * rate);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [--reference NAME] [--output FILE] capture...\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    std::string reference = "lcd";
+    const char *outputPath = NULL;
+
+    static const struct option options[] = {
+        {"reference", required_argument, NULL, 'r'},
+        {"output", required_argument, NULL, 'o'},
+        {NULL, 0, NULL, 0}};
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "r:o:", options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'r': reference = optarg; break;
+        case 'o': outputPath = optarg; break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (optind >= argc)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::map<std::string, TraceStream> streams;
+    for (int i = optind; i < argc; i++)
+        if (!readCapture(argv[i], streams))
+            fprintf(stderr, "[X] skipping %s: unreadable\n", argv[i]);
+
+    if (!streams.count(reference))
+    {
+        fprintf(stderr, "[X] no TRACE lines from the reference MCU '%s'\n", reference.c_str());
+        return 1;
+    }
+
+    // align every stream onto the reference clock
+    std::vector<int64_t> refSyncs = syncTimes(streams[reference]);
+    int64_t origin = INT64_MAX;
+
+    for (auto &entry : streams)
+    {
+        TraceStream &stream = entry.second;
+        if (entry.first == reference)
+        {
+            for (const TraceEvent &ev : stream.events)
+                origin = std::min(origin, ev.time);
+            continue;
+        }
+
+        std::vector<int64_t> ownSyncs = syncTimes(stream);
+        size_t n = std::min(ownSyncs.size(), refSyncs.size());
+        std::vector<std::pair<int64_t, int64_t>> pairs;
+        for (size_t i = 0; i < n; i++)
+            pairs.push_back({ownSyncs[ownSyncs.size() - n + i], refSyncs[refSyncs.size() - n + i]});
+
+        if (pairs.empty())
+            fprintf(stderr, "[!] %s: no sync pulses in common with %s, left unaligned\n",
+                    entry.first.c_str(), reference.c_str());
+        else if (pairs.size() == 1)
+            fprintf(stderr, "%s: 1 sync pair, offset only\n", entry.first.c_str());
+        else
+        {
+            double own = double(pairs.back().first - pairs.front().first);
+            double ref = double(pairs.back().second - pairs.front().second);
+            fprintf(stderr, "%s: %zu sync pairs, drift %+.1f ppm against %s\n",
+                    entry.first.c_str(), pairs.size(), (own / ref - 1.0) * 1e6, reference.c_str());
+        }
+
+        for (TraceEvent &ev : stream.events)
+        {
+            ev.time = alignTime(ev.time, pairs);
+            origin = std::min(origin, ev.time);
+        }
+    }
+
+    FILE *out = outputPath ? fopen(outputPath, "w") : stdout;
+    if (!out)
+    {
+        fprintf(stderr, "[X] can't write %s\n", outputPath);
+        return 1;
+    }
+
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    int pid = 0;
+    for (const auto &entry : streams)
+    {
+        pid++;
+        fprintf(out, "%s{\"ph\":\"M\",\"pid\":%d,\"name\":\"process_name\",\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", pid, entry.first.c_str());
+        first = false;
+
+        const std::vector<TraceEvent> &events = entry.second.events;
+        for (size_t i = 0; i < events.size(); i++)
+        {
+            const TraceEvent &ev = events[i];
+            long long ts = ev.time - origin;
+            if (i + 1 < events.size() && events[i + 1].time >= ev.time)
+                fprintf(out, ",\n{\"ph\":\"X\",\"pid\":%d,\"tid\":0,\"ts\":%lld,\"dur\":%lld,\"name\":\"%s\",\"args\":{\"arg\":%u}}",
+                        pid, ts, (long long)(events[i + 1].time - ev.time), eventName(ev.event), ev.arg);
+            else
+                fprintf(out, ",\n{\"ph\":\"i\",\"s\":\"p\",\"pid\":%d,\"tid\":0,\"ts\":%lld,\"name\":\"%s\",\"args\":{\"arg\":%u}}",
+                        pid, ts, eventName(ev.event), ev.arg);
+        }
+    }
+    fprintf(out, "\n]}\n");
+
+    if (out != stdout)
+        fclose(out);
+
+    size_t total = 0;
+    for (const auto &entry : streams)
+        total += entry.second.events.size();
+    fprintf(stderr, "%zu events from %zu MCUs\n", total, streams.size());
+    return 0;
+}
@@ -0,0 +1,106 @@
+/*
+ * uart_check.c - native check of the non-blocking line input in uart.c, through the host HAL (hal_host.c)
+ *
+ * Feeds scripted console input to uart_try_line() and uart_try_scanf() with hal_host_uart_input() and checks
+ * what comes out: CR, LF and CRLF endings (no empty line from the LF of a CRLF), lines that arrive in pieces,
+ * backspace editing, %Ns word truncation and the %d range check. Exit status is 1 if any check fails.
+ *
+ * The host build has no RX ring (HAL_HOST reads the UART directly), so this exercises the line assembler and
+ * the parser, not the interrupt.
+ *
+ * Build (from code/host_code):
+ *   gcc -O2 -std=gnu99 -DHAL_HOST -I../c_code ../c_code/uart.c hal_host.c uart_check.c -o uart_check
+ */
+
+#include "uart.h"
+#include "hal.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static int failures;
+
+// uart_init() hooks stdio on the AVR; nothing here calls it
+void __init_stdout(int (*put)(char, FILE *)) { (void)put; }
+void __init_stdin(int (*get)(FILE *)) { (void)get; }
+
+static void check(int ok, const char *what)
+{
+    printf("%s %s\n", ok ? "[ok]" : "[X] ", what);
+    if (!ok)
+        failures++;
+}
+
+static int line_is(const char *expected)
+{
+    const char *line = uart_try_line();
+    return line && strcmp(line, expected) == 0;
+}
+
+static void check_endings(void)
+{
+    hal_host_uart_input("status\r");
+    check(line_is("status") && uart_line_ending == UART_ENDING_CR, "CR ends a line");
+
+    hal_host_uart_input("stats\n");
+    check(line_is("stats") && uart_line_ending == UART_ENDING_LF, "LF ends a line");
+
+    hal_host_uart_input("one\r\ntwo\r\n");
+    check(line_is("one"), "CRLF: first line");
+    check(line_is("two"), "CRLF: no empty line in between");
+    // the LF after "two" is only read on the next call, that is when the ending is known
+    check(uart_try_line() == NULL && uart_line_ending == UART_ENDING_CRLF, "CRLF: nothing left over, CRLF seen");
+}
+
+static void check_partial(void)
+{
+    check(uart_try_line() == NULL, "no input, no line");
+
+    hal_host_uart_input("sta");
+    check(uart_try_line() == NULL, "half a line is held back");
+    hal_host_uart_input("tus\r");
+    check(line_is("status"), "the rest completes it");
+
+    hal_host_uart_input("stx\bats\r");
+    check(line_is("stats"), "backspace removes a character");
+}
+
+static void check_scanf(void)
+{
+    char word[8];
+    int value;
+
+    check(uart_try_scanf("%7s", word) == -1, "scanf without a line returns -1");
+
+    hal_host_uart_input("abcdefghij\r");
+    check(uart_try_scanf("%7s", word) == 1 && strcmp(word, "abcdefg") == 0, "%7s truncates a long word");
+
+    hal_host_uart_input("  stats  \r");
+    check(uart_try_scanf("%7s", word) == 1 && strcmp(word, "stats") == 0, "%7s skips surrounding spaces");
+
+    hal_host_uart_input("32767\r");
+    check(uart_try_scanf("%d", &value) == 1 && value == 32767, "%d takes 32767");
+
+    hal_host_uart_input("-32768\r");
+    check(uart_try_scanf("%d", &value) == 1 && value == -32768, "%d takes -32768");
+
+    hal_host_uart_input("32768\r");
+    check(uart_try_scanf("%d", &value) == 0, "%d rejects 32768");
+
+    hal_host_uart_input("99999999999\r");
+    check(uart_try_scanf("%d", &value) == 0, "%d rejects a long overflow");
+
+    hal_host_uart_input("id 12 x\r");
+    char letter;
+    check(uart_try_scanf("id %d %c", &value, &letter) == 2 && value == 12 && letter == 'x', "mixed format");
+}
+
+int main(void)
+{
+    check_endings();
+    check_partial();
+    check_scanf();
+
+    printf("%d failed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,14 @@
+/*
+ * util/atomic.h for host builds - nothing interrupts a check, so an atomic block is an ordinary block
+ */
+
+#ifndef AVR_HOST_ATOMIC_H_
+#define AVR_HOST_ATOMIC_H_
+
+#include <stdint.h>
+
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+#define ATOMIC_BLOCK(type) for (uint8_t atomic_once_ = 1; atomic_once_; atomic_once_ = 0)
+
+#endif /* AVR_HOST_ATOMIC_H_ */